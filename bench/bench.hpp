@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace gx {
+class Box;
+} // namespace gx
+
+namespace bench {
+
+// A benchmark body runs its workload `iterations` times; the harness reports
+// the median time per iteration over several repetitions.
+struct Benchmark {
+    std::string name;
+    size_t iterations = 1;
+    std::function<void(size_t iterations)> body;
+};
+
+std::vector<Benchmark>& registry();
+
+inline bool add(std::string name, size_t iterations,
+    std::function<void(size_t iterations)> body)
+{
+    registry().push_back(Benchmark{
+        .name = std::move(name),
+        .iterations = iterations,
+        .body = std::move(body),
+    });
+    return true;
+}
+
+// Box with a hidden window and the software renderer, shared by all
+// benchmarks that need SDL. Created on first use.
+gx::Box& headlessBox();
+
+template <class T>
+void doNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+} // namespace bench
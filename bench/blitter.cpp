@@ -0,0 +1,190 @@
+#include "bench.hpp"
+
+#include "build-info.hpp"
+
+#include <gx/blitter.hpp>
+#include <gx/box.hpp>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int rowLength = 1024;
+constexpr size_t spriteCount = 1000;
+
+// Mix of opaque, transparent and translucent premultiplied pixels, like
+// the edges of a sprite
+const std::vector<std::uint32_t>& spriteRow()
+{
+    static const auto row = [] {
+        auto random = std::mt19937{42};
+        auto pixels = std::vector<std::uint32_t>(rowLength);
+        for (auto& pixel : pixels) {
+            auto kind = random() % 4;
+            auto alpha = kind == 0 ? 0u : kind == 1 ? random() % 256 : 255u;
+            pixel = alpha << 24 | (alpha / 2) << 16 | (alpha / 3) << 8;
+        }
+        return pixels;
+    }();
+    return row;
+}
+
+const char* levelName(gx::SimdLevel level)
+{
+    switch (level) {
+        case gx::SimdLevel::Scalar:
+            return "scalar";
+        case gx::SimdLevel::Sse2:
+            return "sse2";
+        case gx::SimdLevel::Avx2:
+            return "avx2";
+    }
+    return "";
+}
+
+bool addKernels(gx::SimdLevel level)
+{
+    // Only levels the CPU runs, so that names never lie about what was run
+    if (level > gx::detectSimdLevel()) {
+        return true;
+    }
+    const auto& kernels = gx::blitKernels(level);
+    auto suffix = std::string{"-"} + levelName(level);
+
+    return
+        bench::add("blit/fill" + suffix, 10'000, [&kernels] (size_t n) {
+            auto row = std::vector<std::uint32_t>(rowLength);
+            for (size_t i = 0; i < n; i++) {
+                kernels.fill(row.data(), (std::uint32_t)i, rowLength);
+            }
+            bench::doNotOptimize(row);
+        }) &&
+        bench::add("blit/copy" + suffix, 10'000, [&kernels] (size_t n) {
+            auto row = std::vector<std::uint32_t>(rowLength);
+            for (size_t i = 0; i < n; i++) {
+                kernels.copy(row.data(), spriteRow().data(), rowLength);
+            }
+            bench::doNotOptimize(row);
+        }) &&
+        bench::add("blit/blend" + suffix, 10'000, [&kernels] (size_t n) {
+            auto row = std::vector<std::uint32_t>(rowLength, 0xFF204060);
+            for (size_t i = 0; i < n; i++) {
+                kernels.blend(row.data(), spriteRow().data(), rowLength);
+            }
+            bench::doNotOptimize(row);
+        }) &&
+        bench::add("blit/expand-4x" + suffix, 10'000, [&kernels] (size_t n) {
+            auto row = std::vector<std::uint32_t>(rowLength);
+            for (size_t i = 0; i < n; i++) {
+                kernels.expand(
+                    row.data(), spriteRow().data(), rowLength, 4, 0);
+            }
+            bench::doNotOptimize(row);
+        }) &&
+        bench::add("blit/lookup" + suffix, 10'000, [&kernels] (size_t n) {
+            auto row = std::vector<std::uint32_t>(rowLength);
+            auto indices = std::vector<std::uint8_t>(rowLength);
+            for (size_t i = 0; i < indices.size(); i++) {
+                indices[i] = (std::uint8_t)(i * 7);
+            }
+            for (size_t i = 0; i < n; i++) {
+                kernels.lookup(
+                    row.data(), indices.data(), spriteRow().data(), rowLength);
+            }
+            bench::doNotOptimize(row);
+        }) &&
+        bench::add("blit/premultiply" + suffix, 10'000, [&kernels] (size_t n) {
+            auto row = std::vector<std::uint32_t>(rowLength);
+            for (size_t i = 0; i < n; i++) {
+                kernels.premultiply(row.data(), spriteRow().data(), rowLength);
+            }
+            bench::doNotOptimize(row);
+        });
+}
+
+const std::vector<gx::ScreenPoint>& positions(const gx::ScreenVector& size)
+{
+    static const auto points = [&size] {
+        auto random = std::mt19937{42};
+        auto x = std::uniform_real_distribution<float>{0.f, size.x};
+        auto y = std::uniform_real_distribution<float>{0.f, size.y};
+        auto points = std::vector<gx::ScreenPoint>{};
+        for (size_t i = 0; i < spriteCount; i++) {
+            points.push_back({x(random), y(random)});
+        }
+        return points;
+    }();
+    return points;
+}
+
+// The example's grass sprites at zoom 4 over a 1024x768 window, including
+// the upload of the framebuffer for the blitter
+void drawSprites(
+    gx::Renderer& renderer, const gx::Bitmap& grass, size_t iterations)
+{
+    auto frameSize = gx::PixelVector{grass.size().x / 2, grass.size().y};
+    const auto& points = positions(renderer.windowSize());
+
+    for (size_t i = 0; i < iterations; i++) {
+        renderer.clear();
+        for (size_t j = 0; j < points.size(); j++) {
+            auto frame = gx::PixelRectangle{
+                (int)(j % 2) * frameSize.x, 0, frameSize.x, frameSize.y};
+            renderer.draw(grass, frame, points.at(j), 4.f);
+        }
+        renderer.present();
+    }
+}
+
+gx::Bitmap loadGrass(gx::Renderer& renderer)
+{
+    return renderer.loadBitmap(gx::SOURCE_ROOT / "example" / "grass.png");
+}
+
+void sdlSoftware(size_t iterations)
+{
+    auto& renderer = bench::headlessBox().renderer();
+    static const auto grass = loadGrass(renderer);
+    drawSprites(renderer, grass, iterations);
+}
+
+// Scaling every sprite while drawing, as before the scaled cache
+void sdlSoftwareUncached(size_t iterations)
+{
+    bench::headlessBox();
+    static auto renderer = gx::Renderer{gx::WindowConfig{
+        .headless = true,
+        .scaledCacheBytes = 0,
+    }};
+    static const auto grass = loadGrass(renderer);
+    drawSprites(renderer, grass, iterations);
+}
+
+template <int threads>
+void blitter(size_t iterations)
+{
+    // SDL is initialized by the box
+    bench::headlessBox();
+    static auto renderer = gx::Renderer{gx::WindowConfig{
+        .headless = true,
+        .blitter = true,
+        .blitterThreads = threads,
+    }};
+    static const auto grass = loadGrass(renderer);
+    drawSprites(renderer, grass, iterations);
+}
+
+const auto registered =
+    addKernels(gx::SimdLevel::Scalar) &&
+    addKernels(gx::SimdLevel::Sse2) &&
+    addKernels(gx::SimdLevel::Avx2) &&
+    bench::add("render/sprites-1k-sdl-software", 10, sdlSoftware) &&
+    bench::add(
+        "render/sprites-1k-sdl-software-uncached", 10, sdlSoftwareUncached) &&
+    bench::add("render/sprites-1k-blitter", 10, blitter<1>) &&
+    bench::add("render/sprites-1k-blitter-all-cores", 10, blitter<0>);
+
+} // namespace
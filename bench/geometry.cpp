@@ -0,0 +1,125 @@
+#include "bench.hpp"
+
+#include <gx/geometry.hpp>
+#include <gx/scene.hpp>
+
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t pointCount = 1024;
+
+std::vector<gx::WorldPoint> randomPoints()
+{
+    auto random = std::mt19937{42};
+    auto coordinate = std::uniform_real_distribution<float>{-100.f, 100.f};
+    auto points = std::vector<gx::WorldPoint>{};
+    for (size_t i = 0; i < pointCount; i++) {
+        points.push_back({coordinate(random), coordinate(random)});
+    }
+    return points;
+}
+
+const auto& points()
+{
+    static const auto points = randomPoints();
+    return points;
+}
+
+void vectorArithmetic(size_t iterations)
+{
+    auto sum = gx::WorldVector{};
+    for (size_t i = 0; i < iterations; i++) {
+        const auto& a = points()[i % pointCount];
+        const auto& b = points()[(i + 1) % pointCount];
+        sum += (a - b) * 0.5f + gx::WorldVector{1.f, -1.f} / 2.f;
+    }
+    bench::doNotOptimize(sum);
+}
+
+void normalize(size_t iterations)
+{
+    auto sum = gx::WorldVector{};
+    for (size_t i = 0; i < iterations; i++) {
+        const auto& a = points()[i % pointCount];
+        sum += (a - gx::WorldPoint{}).normalized();
+    }
+    bench::doNotOptimize(sum);
+}
+
+void distance(size_t iterations)
+{
+    float sum = 0.f;
+    for (size_t i = 0; i < iterations; i++) {
+        sum += gx::distance(
+            points()[i % pointCount], points()[(i + 7) % pointCount]);
+    }
+    bench::doNotOptimize(sum);
+}
+
+void rectangleContains(size_t iterations)
+{
+    auto rectangle = gx::Rectangle<float, gx::WorldTag>{-50, -50, 100, 100};
+    size_t count = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        count += rectangle.contains(points()[i % pointCount]);
+    }
+    bench::doNotOptimize(count);
+}
+
+gx::Camera camera()
+{
+    auto camera = gx::Camera{};
+    camera.position = {3.f, -2.f};
+    camera.unitPixelSize = 16.f;
+    camera.zoom = 4.f;
+    return camera;
+}
+
+void worldToScreen(size_t iterations)
+{
+    auto c = camera();
+    auto sum = gx::ScreenVector{};
+    for (size_t i = 0; i < iterations; i++) {
+        sum += c.worldPointToScreenOffset(points()[i % pointCount]);
+    }
+    bench::doNotOptimize(sum);
+}
+
+void screenToWorld(size_t iterations)
+{
+    auto c = camera();
+    auto sum = gx::WorldVector{};
+    for (size_t i = 0; i < iterations; i++) {
+        const auto& point = points()[i % pointCount];
+        sum += c.screenOffsetToWorldPoint({point.x, point.y}) -
+            gx::WorldPoint{};
+    }
+    bench::doNotOptimize(sum);
+}
+
+void cameraFollow(size_t iterations)
+{
+    auto c = camera();
+    auto target = gx::Object{};
+    c.follow = &target;
+    for (size_t i = 0; i < iterations; i++) {
+        target.position = points()[i % pointCount];
+        c.update(1.f / 60.f);
+    }
+    bench::doNotOptimize(c);
+}
+
+constexpr size_t operations = 1'000'000;
+
+const auto registered =
+    bench::add("geometry/vector-arithmetic", operations, vectorArithmetic) &&
+    bench::add("geometry/normalize", operations, normalize) &&
+    bench::add("geometry/distance", operations, distance) &&
+    bench::add("geometry/rectangle-contains", operations, rectangleContains) &&
+    bench::add("camera/world-to-screen", operations, worldToScreen) &&
+    bench::add("camera/screen-to-world", operations, screenToWorld) &&
+    bench::add("camera/follow", operations, cameraFollow);
+
+} // namespace
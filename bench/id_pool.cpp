@@ -0,0 +1,111 @@
+#include "bench.hpp"
+
+#include <gx/id.hpp>
+
+#include <barrier>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+constexpr std::uint32_t poolCapacity = 1 << 20;
+constexpr size_t liveIdsPerThread = 256;
+
+// What callers had to do before ConcurrentIdPool existed
+class LockedIdPool {
+public:
+    gx::Id create()
+    {
+        auto lock = std::scoped_lock{_mutex};
+        return _pool.create();
+    }
+
+    void kill(gx::Id id)
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _pool.kill(id);
+    }
+
+private:
+    std::mutex _mutex;
+    gx::IdPool _pool;
+};
+
+// Every thread keeps a window of live ids, killing the oldest one for each new
+// one it creates
+template <class Pool>
+void spawnChurn(Pool& pool, size_t operations)
+{
+    auto ids = std::vector<gx::Id>{};
+    ids.reserve(liveIdsPerThread);
+    for (size_t i = 0; i < liveIdsPerThread; i++) {
+        ids.push_back(pool.create());
+    }
+
+    for (size_t i = 0; i < operations; i++) {
+        auto& id = ids[i % liveIdsPerThread];
+        pool.kill(id);
+        id = pool.create();
+    }
+
+    for (auto id : ids) {
+        pool.kill(id);
+    }
+    if constexpr (requires { pool.flushThreadCache(); }) {
+        pool.flushThreadCache();
+    }
+}
+
+template <class Pool>
+auto contended(unsigned threadCount)
+{
+    return [threadCount] (size_t iterations) {
+        static auto pool = [] {
+            if constexpr (std::is_same_v<Pool, gx::ConcurrentIdPool>) {
+                return std::make_unique<Pool>(poolCapacity);
+            } else {
+                return std::make_unique<Pool>();
+            }
+        }();
+
+        auto start = std::barrier{threadCount};
+        auto threads = std::vector<std::thread>{};
+        for (unsigned i = 0; i < threadCount; i++) {
+            threads.emplace_back([&start, iterations, threadCount] {
+                start.arrive_and_wait();
+                spawnChurn(*pool, iterations / threadCount);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+}
+
+bool registerAll()
+{
+    static constexpr size_t operations = 1'000'000;
+
+    bench::add("id-pool/serial", operations, [] (size_t iterations) {
+        auto pool = gx::IdPool{};
+        spawnChurn(pool, iterations);
+        bench::doNotOptimize(pool);
+    });
+
+    for (unsigned threads : {1, 2, 4, 8, 16, 32}) {
+        auto suffix = "/threads-" + std::to_string(threads);
+        bench::add("id-pool/locked" + suffix, operations,
+            contended<LockedIdPool>(threads));
+        bench::add("id-pool/concurrent" + suffix, operations,
+            contended<gx::ConcurrentIdPool>(threads));
+    }
+    return true;
+}
+
+const auto registered = registerAll();
+
+} // namespace
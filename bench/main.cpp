@@ -0,0 +1,119 @@
+#include "bench.hpp"
+
+#include <gx/box.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+std::vector<Benchmark>& registry()
+{
+    static auto benchmarks = std::vector<Benchmark>{};
+    return benchmarks;
+}
+
+gx::Box& headlessBox()
+{
+    static auto box = gx::Box{gx::WindowConfig{.headless = true}};
+    return box;
+}
+
+} // namespace bench
+
+namespace {
+
+struct Result {
+    std::string name;
+    size_t iterations = 0;
+    double medianNs = 0.0;
+    double minNs = 0.0;
+    double maxNs = 0.0;
+};
+
+void writeText(const Result& result)
+{
+    std::cout << std::left << std::setw(48) << result.name <<
+        std::right << std::setw(14) << std::fixed <<
+        std::setprecision(2) << result.medianNs << " ns/op\n";
+}
+
+// One object per benchmark, so that results of two releases can be diffed
+// line by line
+void writeJson(const std::vector<Result>& results)
+{
+    std::cout << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& result = results.at(i);
+        std::cout << (i == 0 ? "\n" : ",\n") << std::fixed <<
+            std::setprecision(3) <<
+            "    {\"name\": \"" << result.name << "\"" <<
+            ", \"iterations\": " << result.iterations <<
+            ", \"median_ns\": " << result.medianNs <<
+            ", \"min_ns\": " << result.minNs <<
+            ", \"max_ns\": " << result.maxNs << "}";
+    }
+    std::cout << "\n  ]\n}\n";
+}
+
+} // namespace
+
+// Usage: gx-bench [--json] [name filter]
+int main(int argc, char* argv[])
+{
+    using Clock = std::chrono::steady_clock;
+    static constexpr int repetitions = 7;
+
+    bool json = false;
+    auto filter = std::string_view{};
+    for (int i = 1; i < argc; i++) {
+        if (std::string_view{argv[i]} == "--json") {
+            json = true;
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    auto results = std::vector<Result>{};
+    for (const auto& benchmark : bench::registry()) {
+        if (benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        // Warm caches and allocators before measuring
+        benchmark.body(benchmark.iterations);
+
+        auto samples = std::vector<double>{};
+        for (int i = 0; i < repetitions; i++) {
+            auto start = Clock::now();
+            benchmark.body(benchmark.iterations);
+            auto elapsed = std::chrono::duration<double, std::nano>(
+                Clock::now() - start);
+            samples.push_back(
+                elapsed.count() / (double)benchmark.iterations);
+        }
+        std::ranges::sort(samples);
+
+        auto result = Result{
+            .name = benchmark.name,
+            .iterations = benchmark.iterations,
+            .medianNs = samples.at(samples.size() / 2),
+            .minNs = samples.front(),
+            .maxNs = samples.back(),
+        };
+        if (!json) {
+            writeText(result);
+        }
+        results.push_back(std::move(result));
+    }
+
+    if (json) {
+        writeJson(results);
+    }
+}
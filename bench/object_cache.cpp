@@ -0,0 +1,163 @@
+#include "bench.hpp"
+
+#include <gx/id.hpp>
+
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+struct Particle {
+    float x = 0.f;
+    float y = 0.f;
+    float vx = 0.f;
+    float vy = 0.f;
+};
+
+// The std::map based cache that ObjectCache used to be, kept for comparison
+class MapObjectCache {
+public:
+    gx::Id push(Particle&& particle)
+    {
+        auto id = create();
+        _objects.emplace(id, std::move(particle));
+        return id;
+    }
+
+    void pop(gx::Id id)
+    {
+        _objects.erase(id);
+        _free.push(id);
+    }
+
+    Particle& operator[](gx::Id id)
+    {
+        return _objects.at(id);
+    }
+
+    auto begin() { return _objects.begin(); }
+    auto end() { return _objects.end(); }
+
+private:
+    gx::Id create()
+    {
+        if (!_free.empty()) {
+            auto id = _free.front();
+            _free.pop();
+            return id;
+        }
+        return gx::Id{_nextId++};
+    }
+
+    std::map<gx::Id, Particle> _objects;
+    std::queue<gx::Id> _free;
+    gx::Id::Base _nextId = 1;
+};
+
+using SlotObjectCache = gx::ObjectCache<gx::Id, Particle>;
+
+constexpr size_t objectCount = 10'000;
+
+template <class Cache>
+std::vector<gx::Id> fill(Cache& cache, size_t count)
+{
+    auto ids = std::vector<gx::Id>{};
+    ids.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        ids.push_back(cache.push(Particle{.x = (float)i, .vx = 1.f}));
+    }
+    return ids;
+}
+
+std::vector<gx::Id> shuffled(std::vector<gx::Id> ids)
+{
+    auto random = std::mt19937{42};
+    std::ranges::shuffle(ids, random);
+    return ids;
+}
+
+template <class Cache>
+void insertErase(size_t iterations)
+{
+    auto cache = Cache{};
+    auto ids = shuffled(fill(cache, iterations));
+    for (auto id : ids) {
+        cache.pop(id);
+    }
+    bench::doNotOptimize(cache);
+}
+
+template <class Cache>
+void churn(size_t iterations)
+{
+    auto cache = Cache{};
+    auto ids = fill(cache, objectCount);
+    for (size_t i = 0; i < iterations; i++) {
+        auto& id = ids[i % ids.size()];
+        cache.pop(id);
+        id = cache.push(Particle{.x = (float)i});
+    }
+    bench::doNotOptimize(cache);
+}
+
+template <class Cache>
+void lookup(size_t iterations)
+{
+    static auto cache = Cache{};
+    static auto ids = shuffled(fill(cache, objectCount));
+
+    float sum = 0.f;
+    for (size_t i = 0; i < iterations; i++) {
+        sum += cache[ids[i % ids.size()]].x;
+    }
+    bench::doNotOptimize(sum);
+}
+
+template <class Cache>
+void iterate(size_t iterations)
+{
+    static auto cache = [] {
+        auto cache = Cache{};
+        auto ids = shuffled(fill(cache, objectCount * 2));
+        ids.erase(ids.begin() + objectCount, ids.end());
+        for (auto id : ids) {
+            cache.pop(id);
+        }
+        return cache;
+    }();
+
+    for (size_t i = 0; i < iterations; i++) {
+        for (auto&& entry : cache) {
+            auto& particle = [&] () -> Particle& {
+                if constexpr (std::is_same_v<Cache, MapObjectCache>) {
+                    return entry.second;
+                } else {
+                    return entry;
+                }
+            }();
+            particle.x += particle.vx;
+        }
+    }
+    bench::doNotOptimize(cache);
+}
+
+const auto registered =
+    bench::add("object-cache/map/insert-erase", objectCount,
+        insertErase<MapObjectCache>) &&
+    bench::add("object-cache/slot/insert-erase", objectCount,
+        insertErase<SlotObjectCache>) &&
+    bench::add("object-cache/map/churn", objectCount, churn<MapObjectCache>) &&
+    bench::add("object-cache/slot/churn", objectCount,
+        churn<SlotObjectCache>) &&
+    bench::add("object-cache/map/lookup", objectCount,
+        lookup<MapObjectCache>) &&
+    bench::add("object-cache/slot/lookup", objectCount,
+        lookup<SlotObjectCache>) &&
+    bench::add("object-cache/map/iterate-10k", 10, iterate<MapObjectCache>) &&
+    bench::add("object-cache/slot/iterate-10k", 10, iterate<SlotObjectCache>);
+
+} // namespace
@@ -0,0 +1,101 @@
+#include "bench.hpp"
+
+#include "build-info.hpp"
+
+#include <gx/box.hpp>
+#include <gx/error.hpp>
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::byte> readFile(const std::filesystem::path& path)
+{
+    auto input = std::ifstream{path, std::ios::binary};
+    if (!input) {
+        throw gx::Error{"cannot read " + path.string()};
+    }
+    auto bytes = std::vector<std::byte>{};
+    for (auto it = std::istreambuf_iterator<char>{input};
+            it != std::istreambuf_iterator<char>{}; ++it) {
+        bytes.push_back(static_cast<std::byte>(*it));
+    }
+    return bytes;
+}
+
+void loadBitmap(size_t iterations)
+{
+    static const auto png =
+        readFile(gx::SOURCE_ROOT / "example" / "hero.png");
+
+    auto& box = bench::headlessBox();
+    for (size_t i = 0; i < iterations; i++) {
+        auto bitmap = box.loadBitmap(png);
+        bench::doNotOptimize(bitmap);
+    }
+}
+
+void loadBitmapFile(size_t iterations)
+{
+    auto& renderer = bench::headlessBox().renderer();
+    for (size_t i = 0; i < iterations; i++) {
+        auto bitmap =
+            renderer.loadBitmap(gx::SOURCE_ROOT / "example" / "hero.png");
+        bench::doNotOptimize(bitmap);
+    }
+}
+
+// Decoding, conversion and premultiplication without a texture upload
+void loadBitmapBlitter(size_t iterations)
+{
+    static const auto png =
+        readFile(gx::SOURCE_ROOT / "example" / "hero.png");
+
+    // SDL is initialized by the box
+    bench::headlessBox();
+    static auto renderer = gx::Renderer{gx::WindowConfig{
+        .headless = true,
+        .blitter = true,
+    }};
+    for (size_t i = 0; i < iterations; i++) {
+        auto bitmap = renderer.loadBitmap(png);
+        bench::doNotOptimize(bitmap);
+    }
+}
+
+void loadCursor(size_t iterations)
+{
+    bench::headlessBox();
+    for (size_t i = 0; i < iterations; i++) {
+        auto cursor = gx::Renderer::loadCursor(
+            gx::SOURCE_ROOT / "example" / "cursor.png", 0, 0);
+        bench::doNotOptimize(cursor);
+    }
+}
+
+void prepareText(size_t iterations)
+{
+    // TTF must be initialized by the box before the font is opened
+    auto& renderer = bench::headlessBox().renderer();
+    static const auto font =
+        gx::Font{gx::SOURCE_ROOT / "example" / "nasalization-rg.otf", 18};
+
+    for (size_t i = 0; i < iterations; i++) {
+        auto bitmap = renderer.prepareText(
+            font, "Score: " + std::to_string(i), {255, 255, 255, 255});
+        bench::doNotOptimize(bitmap);
+    }
+}
+
+const auto registered =
+    bench::add("renderer/load-bitmap-memory", 100, loadBitmap) &&
+    bench::add("renderer/load-bitmap-file", 100, loadBitmapFile) &&
+    bench::add("renderer/load-bitmap-blitter", 100, loadBitmapBlitter) &&
+    bench::add("renderer/load-cursor", 100, loadCursor) &&
+    bench::add("renderer/prepare-text", 100, prepareText);
+
+} // namespace
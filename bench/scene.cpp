@@ -0,0 +1,88 @@
+#include "bench.hpp"
+
+#include "build-info.hpp"
+
+#include <gx/box.hpp>
+#include <gx/scene.hpp>
+#include <gx/sprite.hpp>
+
+#include <memory>
+#include <random>
+
+namespace {
+
+constexpr size_t objectCount = 1000;
+
+// Animated 2-frame sprite, as in the example
+const gx::Sprite& sprite()
+{
+    static const auto grass = bench::headlessBox().loadBitmap(
+        gx::SOURCE_ROOT / "example" / "grass.png");
+    static const auto sprite = gx::createSimpleSprite(grass, 2, 3);
+    return sprite;
+}
+
+void fill(gx::Scene& scene, size_t count)
+{
+    auto random = std::mt19937{42};
+    auto coordinate = std::uniform_real_distribution<float>{-20.f, 20.f};
+    for (size_t i = 0; i < count; i++) {
+        scene.spawn(sprite(), {coordinate(random), coordinate(random)});
+    }
+}
+
+void animationUpdate(size_t iterations)
+{
+    auto animation = gx::Animation{sprite()};
+    size_t changes = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        changes += animation.update(1.f / 60.f);
+    }
+    bench::doNotOptimize(changes);
+}
+
+void spawn(size_t iterations)
+{
+    auto scene = gx::Scene{};
+    fill(scene, iterations);
+    bench::doNotOptimize(scene);
+}
+
+void update(size_t iterations)
+{
+    static auto scene = [] {
+        auto scene = std::make_unique<gx::Scene>();
+        fill(*scene, objectCount);
+        return scene;
+    }();
+
+    for (size_t i = 0; i < iterations; i++) {
+        scene->update(1.f / 60.f);
+    }
+}
+
+void render(size_t iterations)
+{
+    auto& renderer = bench::headlessBox().renderer();
+    static auto scene = [&renderer] {
+        auto scene = std::make_unique<gx::Scene>();
+        fill(*scene, objectCount);
+        scene->setupCamera({0, 0}, 16, 1);
+        scene->layout(renderer.windowArea());
+        return scene;
+    }();
+
+    for (size_t i = 0; i < iterations; i++) {
+        renderer.clear();
+        scene->render(renderer);
+        renderer.present();
+    }
+}
+
+const auto registered =
+    bench::add("animation/update", 1'000'000, animationUpdate) &&
+    bench::add("scene/spawn", objectCount, spawn) &&
+    bench::add("scene/update-1k", 100, update) &&
+    bench::add("scene/render-1k", 10, render);
+
+} // namespace
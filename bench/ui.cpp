@@ -0,0 +1,65 @@
+#include "bench.hpp"
+
+#include <gx/box.hpp>
+#include <gx/ui.hpp>
+
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr int columns = 32;
+constexpr int rows = 32;
+
+// A grid of columns * rows buttons covering the whole window, added once
+gx::Box& boxWithWidgets()
+{
+    static auto& box = [] () -> gx::Box& {
+        auto& box = bench::headlessBox();
+        auto size = box.renderer().windowSize();
+        auto w = size.x / columns;
+        auto h = size.y / rows;
+        for (int i = 0; i < columns; i++) {
+            for (int j = 0; j < rows; j++) {
+                box.createWidget<gx::Button>()
+                    ->position(
+                        gx::UiCoordinate{.pixels = w * ((float)i + 0.5f)},
+                        gx::UiCoordinate{.pixels = h * ((float)j + 0.5f)})
+                    ->size(
+                        gx::UiCoordinate{.pixels = w - 2},
+                        gx::UiCoordinate{.pixels = h - 2});
+            }
+        }
+        return box;
+    }();
+    return box;
+}
+
+void widgetAtPosition(size_t iterations)
+{
+    auto& box = boxWithWidgets();
+    static const auto positions = [&box] {
+        auto size = box.renderer().windowSize();
+        auto random = std::mt19937{42};
+        auto x = std::uniform_int_distribution<int>{0, (int)size.x - 1};
+        auto y = std::uniform_int_distribution<int>{0, (int)size.y - 1};
+        auto positions = std::vector<std::pair<int, int>>{};
+        for (int i = 0; i < 1024; i++) {
+            positions.emplace_back(x(random), y(random));
+        }
+        return positions;
+    }();
+
+    size_t hits = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        const auto& [x, y] = positions[i % positions.size()];
+        hits += box.widgetAtPosition(x, y) != nullptr;
+    }
+    bench::doNotOptimize(hits);
+}
+
+const auto registered =
+    bench::add("box/widget-at-position-1k", 1'000'000, widgetAtPosition);
+
+} // namespace
@@ -0,0 +1,866 @@
+#include <gx/blitter.hpp>
+
+#include <gx/error.hpp>
+#include <gx/trace.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GX_BLIT_SIMD
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define GX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define GX_TARGET_AVX2
+#endif
+#endif
+
+namespace gx {
+
+namespace {
+
+// Side of the square tiles that threads rasterize independently, wide
+// enough that two threads rarely write to the same cache line
+constexpr int tileSize = 64;
+
+// x * y / 255, rounded, for x and y up to 255
+std::uint32_t mulDiv255(std::uint32_t x, std::uint32_t y)
+{
+    auto t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+std::uint32_t blendPixel(std::uint32_t dst, std::uint32_t src)
+{
+    auto inverse = 255 - (src >> 24);
+    auto result = std::uint32_t{0};
+    for (int shift = 0; shift < 32; shift += 8) {
+        auto channel = ((src >> shift) & 0xFF) +
+            mulDiv255((dst >> shift) & 0xFF, inverse);
+        result |= std::min(channel, 255u) << shift;
+    }
+    return result;
+}
+
+void fillScalar(std::uint32_t* dst, std::uint32_t color, int count)
+{
+    std::fill_n(dst, count, color);
+}
+
+void copyScalar(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+    std::memcpy(dst, src, (size_t)count * sizeof(std::uint32_t));
+}
+
+void blendScalar(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (src[i] >> 24 == 255) {
+            dst[i] = src[i];
+        } else if (src[i] != 0) {
+            dst[i] = blendPixel(dst[i], src[i]);
+        }
+    }
+}
+
+void expandScalar(
+    std::uint32_t* dst,
+    const std::uint32_t* src,
+    int count,
+    int scale,
+    int phase)
+{
+    if (count <= 0) {
+        return;
+    }
+    auto* end = dst + count;
+    dst = std::fill_n(dst, std::min(scale - phase, count), *src++);
+    while (end - dst >= scale) {
+        dst = std::fill_n(dst, scale, *src++);
+    }
+    if (dst < end) {
+        std::fill_n(dst, end - dst, *src);
+    }
+}
+
+void lookupScalar(
+    std::uint32_t* dst,
+    const std::uint8_t* src,
+    const std::uint32_t* palette,
+    int count)
+{
+    for (int i = 0; i < count; i++) {
+        dst[i] = palette[src[i]];
+    }
+}
+
+std::uint32_t premultiplyPixel(std::uint32_t pixel)
+{
+    auto alpha = pixel >> 24;
+    return (alpha << 24) |
+        (mulDiv255((pixel >> 16) & 0xFF, alpha) << 16) |
+        (mulDiv255((pixel >> 8) & 0xFF, alpha) << 8) |
+        mulDiv255(pixel & 0xFF, alpha);
+}
+
+void premultiplyScalar(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+    for (int i = 0; i < count; i++) {
+        dst[i] = premultiplyPixel(src[i]);
+    }
+}
+
+constexpr auto scalarKernels = BlitKernels{
+    .fill = fillScalar,
+    .copy = copyScalar,
+    .blend = blendScalar,
+    .expand = expandScalar,
+    .lookup = lookupScalar,
+    .premultiply = premultiplyScalar,
+};
+
+#ifdef GX_BLIT_SIMD
+
+__m128i load(const std::uint32_t* src)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+void store(std::uint32_t* dst, __m128i value)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+}
+
+// Per 16-bit lane x * y / 255, rounded
+__m128i mulDiv255(__m128i x, __m128i y)
+{
+    auto t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+__m128i blend4(__m128i dst, __m128i src)
+{
+    auto zero = _mm_setzero_si128();
+    auto inverse =
+        _mm_sub_epi32(_mm_set1_epi32(255), _mm_srli_epi32(src, 24));
+    // Spread each pixel's inverse alpha over its four 16-bit channels
+    inverse = _mm_or_si128(inverse, _mm_slli_epi32(inverse, 16));
+    auto low = mulDiv255(
+        _mm_unpacklo_epi8(dst, zero), _mm_unpacklo_epi32(inverse, inverse));
+    auto high = mulDiv255(
+        _mm_unpackhi_epi8(dst, zero), _mm_unpackhi_epi32(inverse, inverse));
+    return _mm_adds_epu8(src, _mm_packus_epi16(low, high));
+}
+
+void fillSse2(std::uint32_t* dst, std::uint32_t color, int count)
+{
+    auto value = _mm_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        store(dst + i, value);
+    }
+    fillScalar(dst + i, color, count - i);
+}
+
+void copySse2(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        store(dst + i, load(src + i));
+    }
+    copyScalar(dst + i, src + i, count - i);
+}
+
+void blendSse2(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+    auto alpha = _mm_set1_epi32((int)0xFF000000);
+    auto zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto s = load(src + i);
+        // Sprites are mostly opaque or empty, neither needs arithmetic
+        auto opaque = _mm_cmpeq_epi32(_mm_and_si128(s, alpha), alpha);
+        if (_mm_movemask_epi8(opaque) == 0xFFFF) {
+            store(dst + i, s);
+        } else if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) != 0xFFFF) {
+            store(dst + i, blend4(load(dst + i), s));
+        }
+    }
+    blendScalar(dst + i, src + i, count - i);
+}
+
+void expandSse2(
+    std::uint32_t* dst,
+    const std::uint32_t* src,
+    int count,
+    int scale,
+    int phase)
+{
+    if ((scale != 2 && scale != 4) || count <= 0) {
+        expandScalar(dst, src, count, scale, phase);
+        return;
+    }
+
+    auto* end = dst + count;
+    if (phase != 0) {
+        dst = std::fill_n(dst, std::min<int>(scale - phase, count), *src++);
+    }
+    if (scale == 2) {
+        for (; end - dst >= 8; dst += 8, src += 4) {
+            auto v = load(src);
+            store(dst, _mm_unpacklo_epi32(v, v));
+            store(dst + 4, _mm_unpackhi_epi32(v, v));
+        }
+    } else {
+        for (; end - dst >= 16; dst += 16, src += 4) {
+            auto v = load(src);
+            store(dst, _mm_shuffle_epi32(v, 0x00));
+            store(dst + 4, _mm_shuffle_epi32(v, 0x55));
+            store(dst + 8, _mm_shuffle_epi32(v, 0xAA));
+            store(dst + 12, _mm_shuffle_epi32(v, 0xFF));
+        }
+    }
+    expandScalar(dst, src, (int)(end - dst), scale, 0);
+}
+
+void premultiplySse2(std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+    auto alphaMask = _mm_set1_epi32((int)0xFF000000);
+    auto zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto s = load(src + i);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(
+                _mm_and_si128(s, alphaMask), alphaMask)) == 0xFFFF) {
+            store(dst + i, s);
+            continue;
+        }
+        // Same spreading of alpha as in blend4, which also scales alpha
+        // itself, so the original alpha is put back afterwards
+        auto alpha = _mm_srli_epi32(s, 24);
+        alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+        auto low = mulDiv255(
+            _mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi32(alpha, alpha));
+        auto high = mulDiv255(
+            _mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi32(alpha, alpha));
+        auto colors = _mm_andnot_si128(alphaMask, _mm_packus_epi16(low, high));
+        store(dst + i, _mm_or_si128(colors, _mm_and_si128(s, alphaMask)));
+    }
+    premultiplyScalar(dst + i, src + i, count - i);
+}
+
+// SSE2 has no gather, so lookups stay scalar
+constexpr auto sse2Kernels = BlitKernels{
+    .fill = fillSse2,
+    .copy = copySse2,
+    .blend = blendSse2,
+    .expand = expandSse2,
+    .lookup = lookupScalar,
+    .premultiply = premultiplySse2,
+};
+
+GX_TARGET_AVX2 __m256i load8(const std::uint32_t* src)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+}
+
+GX_TARGET_AVX2 void store8(std::uint32_t* dst, __m256i value)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), value);
+}
+
+GX_TARGET_AVX2 __m256i mulDiv255(__m256i x, __m256i y)
+{
+    auto t = _mm256_add_epi16(
+        _mm256_mullo_epi16(x, y), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+// Same as blend4, unpacking and packing within each 128-bit half
+GX_TARGET_AVX2 __m256i blend8(__m256i dst, __m256i src)
+{
+    auto zero = _mm256_setzero_si256();
+    auto inverse = _mm256_sub_epi32(
+        _mm256_set1_epi32(255), _mm256_srli_epi32(src, 24));
+    inverse = _mm256_or_si256(inverse, _mm256_slli_epi32(inverse, 16));
+    auto low = mulDiv255(
+        _mm256_unpacklo_epi8(dst, zero),
+        _mm256_unpacklo_epi32(inverse, inverse));
+    auto high = mulDiv255(
+        _mm256_unpackhi_epi8(dst, zero),
+        _mm256_unpackhi_epi32(inverse, inverse));
+    return _mm256_adds_epu8(src, _mm256_packus_epi16(low, high));
+}
+
+GX_TARGET_AVX2 void fillAvx2(std::uint32_t* dst, std::uint32_t color, int count)
+{
+    auto value = _mm256_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        store8(dst + i, value);
+    }
+    fillSse2(dst + i, color, count - i);
+}
+
+GX_TARGET_AVX2 void copyAvx2(
+    std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        store8(dst + i, load8(src + i));
+    }
+    copySse2(dst + i, src + i, count - i);
+}
+
+GX_TARGET_AVX2 void blendAvx2(
+    std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+    auto alpha = _mm256_set1_epi32((int)0xFF000000);
+    auto zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto s = load8(src + i);
+        auto opaque = _mm256_cmpeq_epi32(_mm256_and_si256(s, alpha), alpha);
+        if (_mm256_movemask_epi8(opaque) == -1) {
+            store8(dst + i, s);
+        } else if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(s, zero)) != -1) {
+            store8(dst + i, blend8(load8(dst + i), s));
+        }
+    }
+    blendSse2(dst + i, src + i, count - i);
+}
+
+GX_TARGET_AVX2 void expandAvx2(
+    std::uint32_t* dst,
+    const std::uint32_t* src,
+    int count,
+    int scale,
+    int phase)
+{
+    if ((scale != 2 && scale != 4) || count <= 0) {
+        expandScalar(dst, src, count, scale, phase);
+        return;
+    }
+
+    auto* end = dst + count;
+    if (phase != 0) {
+        dst = std::fill_n(dst, std::min<int>(scale - phase, count), *src++);
+    }
+    if (scale == 2) {
+        auto first = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+        auto second = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+        for (; end - dst >= 16; dst += 16, src += 8) {
+            auto v = load8(src);
+            store8(dst, _mm256_permutevar8x32_epi32(v, first));
+            store8(dst + 8, _mm256_permutevar8x32_epi32(v, second));
+        }
+    } else {
+        for (; end - dst >= 32; dst += 32, src += 8) {
+            auto v = load8(src);
+            for (int k = 0; k < 4; k++) {
+                auto index = _mm256_setr_epi32(
+                    2 * k, 2 * k, 2 * k, 2 * k,
+                    2 * k + 1, 2 * k + 1, 2 * k + 1, 2 * k + 1);
+                store8(dst + 8 * k, _mm256_permutevar8x32_epi32(v, index));
+            }
+        }
+    }
+    expandSse2(dst, src, (int)(end - dst), scale, 0);
+}
+
+GX_TARGET_AVX2 void lookupAvx2(
+    std::uint32_t* dst,
+    const std::uint8_t* src,
+    const std::uint32_t* palette,
+    int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto indices = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+        store8(dst + i, _mm256_i32gather_epi32(
+            reinterpret_cast<const int*>(palette), indices, 4));
+    }
+    lookupScalar(dst + i, src + i, palette, count - i);
+}
+
+GX_TARGET_AVX2 void premultiplyAvx2(
+    std::uint32_t* dst, const std::uint32_t* src, int count)
+{
+    auto alphaMask = _mm256_set1_epi32((int)0xFF000000);
+    auto zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto s = load8(src + i);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(
+                _mm256_and_si256(s, alphaMask), alphaMask)) == -1) {
+            store8(dst + i, s);
+            continue;
+        }
+        auto alpha = _mm256_srli_epi32(s, 24);
+        alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 16));
+        auto low = mulDiv255(
+            _mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi32(alpha, alpha));
+        auto high = mulDiv255(
+            _mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi32(alpha, alpha));
+        auto colors = _mm256_andnot_si256(
+            alphaMask, _mm256_packus_epi16(low, high));
+        store8(
+            dst + i, _mm256_or_si256(colors, _mm256_and_si256(s, alphaMask)));
+    }
+    premultiplyScalar(dst + i, src + i, count - i);
+}
+
+constexpr auto avx2Kernels = BlitKernels{
+    .fill = fillAvx2,
+    .copy = copyAvx2,
+    .blend = blendAvx2,
+    .expand = expandAvx2,
+    .lookup = lookupAvx2,
+    .premultiply = premultiplyAvx2,
+};
+
+#endif
+
+} // namespace
+
+Image::Image(const PixelVector& size)
+    : _size(size)
+    , _pixels((size_t)size.x * (size_t)size.y, 0)
+{ }
+
+Image::Image(SDL_Surface* surface)
+{
+    auto converted = std::unique_ptr<SDL_Surface, void(*)(SDL_Surface*)>{
+        sdlCheck(SDL_ConvertSurfaceFormat(
+            surface, SDL_PIXELFORMAT_ARGB8888, 0)),
+        SDL_FreeSurface};
+
+    _size = {converted->w, converted->h};
+    _pixels.resize((size_t)_size.x * (size_t)_size.y);
+    _opaque = true;
+
+    const auto& kernels = blitKernels(detectSimdLevel());
+    for (int y = 0; y < _size.y; y++) {
+        const auto* src = reinterpret_cast<const std::uint32_t*>(
+            static_cast<const std::uint8_t*>(converted->pixels) +
+            (ptrdiff_t)y * converted->pitch);
+        kernels.premultiply(row(y), src, _size.x);
+        _opaque = _opaque && std::all_of(src, src + _size.x,
+            [] (std::uint32_t pixel) { return pixel >> 24 == 255; });
+    }
+}
+
+Image::Image(
+    const PixelVector& size,
+    std::shared_ptr<const std::vector<std::uint8_t>> indices,
+    const Palette& palette)
+    : _size(size)
+    , _indices(std::move(indices))
+    , _palette(256, 0)
+{
+    auto used = std::array<bool, 256>{};
+    for (auto index : *_indices) {
+        used[index] = true;
+    }
+
+    _opaque = true;
+    for (size_t i = 0; i < palette.size() && i < _palette.size(); i++) {
+        const auto& color = palette[i];
+        _palette[i] = premultiplyPixel(
+            (std::uint32_t)color.a << 24 | (std::uint32_t)color.r << 16 |
+            (std::uint32_t)color.g << 8 | color.b);
+    }
+    for (size_t i = 0; i < used.size(); i++) {
+        _opaque = _opaque && (!used[i] || _palette[i] >> 24 == 255);
+    }
+}
+
+const PixelVector& Image::size() const
+{
+    return _size;
+}
+
+bool Image::opaque() const
+{
+    return _opaque;
+}
+
+bool Image::indexed() const
+{
+    return _indices != nullptr;
+}
+
+std::uint32_t* Image::row(int y)
+{
+    return _pixels.data() + (ptrdiff_t)y * _size.x;
+}
+
+const std::uint32_t* Image::row(int y) const
+{
+    return _pixels.data() + (ptrdiff_t)y * _size.x;
+}
+
+const std::uint8_t* Image::indexRow(int y) const
+{
+    return _indices->data() + (ptrdiff_t)y * _size.x;
+}
+
+const std::uint32_t* Image::palette() const
+{
+    return _palette.data();
+}
+
+void premultiply(SDL_Surface* surface)
+{
+    if (surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+        throw Error{"only ARGB8888 surfaces can be premultiplied"};
+    }
+    const auto& kernels = blitKernels(detectSimdLevel());
+    for (int y = 0; y < surface->h; y++) {
+        auto* row = reinterpret_cast<std::uint32_t*>(
+            static_cast<std::uint8_t*>(surface->pixels) +
+            (ptrdiff_t)y * surface->pitch);
+        kernels.premultiply(row, row, surface->w);
+    }
+}
+
+SimdLevel detectSimdLevel()
+{
+#ifdef GX_BLIT_SIMD
+    if (SDL_HasAVX2()) {
+        return SimdLevel::Avx2;
+    }
+    if (SDL_HasSSE2()) {
+        return SimdLevel::Sse2;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+const BlitKernels& blitKernels(SimdLevel level)
+{
+#ifdef GX_BLIT_SIMD
+    static const auto supported = detectSimdLevel();
+    if (level <= supported) {
+        switch (level) {
+            case SimdLevel::Avx2:
+                return avx2Kernels;
+            case SimdLevel::Sse2:
+                return sse2Kernels;
+            case SimdLevel::Scalar:
+                break;
+        }
+    }
+#endif
+    (void)level;
+    return scalarKernels;
+}
+
+Blitter::Blitter(int threads, SimdLevel level)
+    : _kernels(blitKernels(level))
+{
+    if (threads <= 0) {
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    for (int i = 1; i < threads; i++) {
+        _workers.emplace_back([this] { work(); });
+    }
+}
+
+Blitter::~Blitter()
+{
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _stopping = true;
+    }
+    _start.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+void Blitter::resize(const PixelVector& size)
+{
+    if (size != _framebuffer.size()) {
+        if (!_target) {
+            _commands.clear();
+        }
+        _framebuffer = Image{size};
+    }
+}
+
+const Image& Blitter::framebuffer() const
+{
+    return _framebuffer;
+}
+
+void Blitter::setTarget(std::shared_ptr<Image> target)
+{
+    flush();
+    _target = std::move(target);
+}
+
+void Blitter::setClip(const std::optional<PixelRectangle>& clip)
+{
+    _clip = clip;
+}
+
+void Blitter::clear(std::uint32_t color)
+{
+    // Nothing drawn before shows through a clear
+    _commands.clear();
+    auto size = target().size();
+    if (size.x > 0 && size.y > 0) {
+        _commands.push_back(Command{
+            .area = {0, 0, size.x, size.y},
+            .color = color,
+        });
+    }
+}
+
+void Blitter::fill(const PixelRectangle& area, std::uint32_t color)
+{
+    if (auto visibleArea = visible(area)) {
+        _commands.push_back(Command{.area = *visibleArea, .color = color});
+    }
+}
+
+void Blitter::draw(
+    std::shared_ptr<const Image> image,
+    const PixelRectangle& frame,
+    const ScreenPoint& position,
+    float zoom,
+    bool opaque)
+{
+    if (frame.x < 0 || frame.y < 0 ||
+            frame.x + frame.w > image->size().x ||
+            frame.y + frame.h > image->size().y) {
+        throw Error{"frame is outside of the image"};
+    }
+
+    auto destination = PixelRectangle{
+        .x = (int)std::lround(position.x - zoom * (float)frame.w / 2.f),
+        .y = (int)std::lround(position.y - zoom * (float)frame.h / 2.f),
+        .w = (int)std::lround(zoom * (float)frame.w),
+        .h = (int)std::lround(zoom * (float)frame.h),
+    };
+    if (auto area = visible(destination)) {
+        opaque = opaque || image->opaque();
+        _commands.push_back(Command{
+            .area = *area,
+            .destination = destination,
+            .frame = frame,
+            .image = std::move(image),
+            .opaque = opaque,
+        });
+    }
+}
+
+void Blitter::flush()
+{
+    if (_commands.empty()) {
+        return;
+    }
+    GX_TRACE_ZONE("Blitter::flush");
+
+    auto size = target().size();
+    _tileColumns = (size.x + tileSize - 1) / tileSize;
+    auto tileRows = (size.y + tileSize - 1) / tileSize;
+
+    if (_workers.empty() || _tileColumns * tileRows < 2) {
+        for (const auto& command : _commands) {
+            execute(command, command.area, _scratch);
+        }
+        _commands.clear();
+        return;
+    }
+
+    _bins.resize((size_t)(_tileColumns * tileRows));
+    for (auto& bin : _bins) {
+        bin.clear();
+    }
+    for (size_t i = 0; i < _commands.size(); i++) {
+        const auto& area = _commands[i].area;
+        auto right = (area.x + area.w - 1) / tileSize;
+        auto bottom = (area.y + area.h - 1) / tileSize;
+        for (int row = area.y / tileSize; row <= bottom; row++) {
+            for (int column = area.x / tileSize; column <= right; column++) {
+                _bins[(size_t)(row * _tileColumns + column)].push_back(
+                    (std::uint32_t)i);
+            }
+        }
+    }
+
+    _nextTile = 0;
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _generation++;
+        _busyWorkers = _workers.size();
+    }
+    _start.notify_all();
+
+    rasterizeTiles(_scratch);
+
+    {
+        auto lock = std::unique_lock{_mutex};
+        _finish.wait(lock, [this] { return _busyWorkers == 0; });
+    }
+    _commands.clear();
+}
+
+Image& Blitter::target()
+{
+    return _target ? *_target : _framebuffer;
+}
+
+std::optional<PixelRectangle> Blitter::visible(const PixelRectangle& area)
+{
+    auto size = target().size();
+    auto result = intersection(area, PixelRectangle{0, 0, size.x, size.y});
+    if (result && _clip) {
+        result = intersection(*result, *_clip);
+    }
+    return result;
+}
+
+void Blitter::execute(
+    const Command& command,
+    const PixelRectangle& bounds,
+    Scratch& scratch)
+{
+    auto area = intersection(command.area, bounds);
+    if (!area) {
+        return;
+    }
+    auto& image = target();
+
+    if (!command.image) {
+        for (int y = area->y; y < area->y + area->h; y++) {
+            _kernels.fill(image.row(y) + area->x, command.color, area->w);
+        }
+        return;
+    }
+
+    const auto& source = *command.image;
+    const auto& frame = command.frame;
+    const auto& destination = command.destination;
+    // Destination pixels cut off on the left by clipping
+    auto skipped = area->x - destination.x;
+    auto blend = command.opaque ? _kernels.copy : _kernels.blend;
+
+    // Colors of count source pixels from x in row y, only expanding
+    // indexed images as far as needed
+    auto pixels = [&] (int y, int x, int count) {
+        if (!source.indexed()) {
+            return source.row(y) + x;
+        }
+        if (scratch.colors.size() < (size_t)count) {
+            scratch.colors.resize((size_t)count);
+        }
+        _kernels.lookup(
+            scratch.colors.data(), source.indexRow(y) + x, source.palette(),
+            count);
+        return static_cast<const std::uint32_t*>(scratch.colors.data());
+    };
+
+    if (destination.w == frame.w && destination.h == frame.h) {
+        for (int y = area->y; y < area->y + area->h; y++) {
+            blend(
+                image.row(y) + area->x,
+                pixels(frame.y + y - destination.y, frame.x + skipped, area->w),
+                area->w);
+        }
+        return;
+    }
+
+    // Scaled rows are expanded once per source row, or straight into the
+    // target when there is nothing to blend
+    auto scale = destination.w / frame.w;
+    bool integral = destination.w == scale * frame.w &&
+        destination.h == scale * frame.h;
+    if (scratch.expanded.size() < (size_t)area->w) {
+        scratch.expanded.resize((size_t)area->w);
+    }
+    int expandedRow = -1;
+    for (int y = area->y; y < area->y + area->h; y++) {
+        auto sourceY = (y - destination.y) * frame.h / destination.h;
+        auto* targetRow = image.row(y) + area->x;
+        auto* expanded =
+            command.opaque ? targetRow : scratch.expanded.data();
+
+        if (command.opaque || sourceY != expandedRow) {
+            if (integral) {
+                auto phase = skipped % scale;
+                _kernels.expand(
+                    expanded,
+                    pixels(
+                        frame.y + sourceY,
+                        frame.x + skipped / scale,
+                        (phase + area->w + scale - 1) / scale),
+                    area->w,
+                    scale,
+                    phase);
+            } else {
+                const auto* sourceRow =
+                    pixels(frame.y + sourceY, frame.x, frame.w);
+                for (int x = 0; x < area->w; x++) {
+                    expanded[x] =
+                        sourceRow[(skipped + x) * frame.w / destination.w];
+                }
+            }
+            expandedRow = sourceY;
+        }
+        if (!command.opaque) {
+            blend(targetRow, expanded, area->w);
+        }
+    }
+}
+
+void Blitter::rasterizeTiles(Scratch& scratch)
+{
+    GX_TRACE_ZONE("Blitter::rasterizeTiles");
+    for (auto tile = _nextTile++; tile < _bins.size(); tile = _nextTile++) {
+        auto bounds = PixelRectangle{
+            .x = (int)(tile % (size_t)_tileColumns) * tileSize,
+            .y = (int)(tile / (size_t)_tileColumns) * tileSize,
+            .w = tileSize,
+            .h = tileSize,
+        };
+        for (auto index : _bins[tile]) {
+            execute(_commands[index], bounds, scratch);
+        }
+    }
+}
+
+void Blitter::work()
+{
+    auto scratch = Scratch{};
+    std::uint64_t done = 0;
+    while (true) {
+        {
+            auto lock = std::unique_lock{_mutex};
+            _start.wait(lock, [&] {
+                return _stopping || _generation != done;
+            });
+            if (_stopping) {
+                return;
+            }
+            done = _generation;
+        }
+
+        rasterizeTiles(scratch);
+
+        auto lock = std::scoped_lock{_mutex};
+        if (--_busyWorkers == 0) {
+            _finish.notify_one();
+        }
+    }
+}
+
+} // namespace gx
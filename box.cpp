@@ -1,23 +1,81 @@
 #include <gx/box.hpp>
 
 #include <gx/error.hpp>
+#include <gx/trace.hpp>
 
 #include <SDL_image.h>
 
-#include <ranges>
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <optional>
 #include <string>
+#include <thread>
 
 namespace gx {
 
-Box::Box()
+namespace {
+
+// Share of the window beyond which dirty rectangles are not worth it
+constexpr float fullRedrawShare = 0.5f;
+
+// Frequent events that gx does not consume. Everything else, including
+// application lifecycle and device events, reaches the queue.
+const Uint32 droppedEvents[] = {
+    SDL_SYSWMEVENT,
+    SDL_TEXTEDITING,
+    SDL_FINGERDOWN,
+    SDL_FINGERUP,
+    SDL_FINGERMOTION,
+    SDL_DOLLARGESTURE,
+    SDL_DOLLARRECORD,
+    SDL_MULTIGESTURE,
+    SDL_SENSORUPDATE,
+};
+
+// Turns pipelining off for the widgets when it goes out of scope
+class PipelineGuard {
+public:
+    explicit PipelineGuard(const std::vector<Widget*>& widgets)
+        : _widgets(widgets)
+    { }
+
+    PipelineGuard(const PipelineGuard&) = delete;
+    PipelineGuard& operator=(const PipelineGuard&) = delete;
+
+    ~PipelineGuard()
+    {
+        for (auto* widget : _widgets) {
+            widget->pipeline(false);
+        }
+    }
+
+private:
+    const std::vector<Widget*>& _widgets;
+};
+
+} // namespace
+
+Box::Box(const WindowConfig& config)
+    : _renderer(config)
 {
     sdlCheck(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS));
     sdlCheck(IMG_Init(IMG_INIT_PNG));
     sdlCheck(TTF_Init());
+
+    for (Uint32 type : droppedEvents) {
+        _droppedEvents[type] = true;
+    }
+    SDL_GetEventFilter(&_previousFilter, &_previousFilterData);
+    SDL_SetEventFilter(filterEvent, this);
+
+    _renderer.setFrameMemory(&_frameArena);
 }
 
 Box::~Box()
 {
+    SDL_SetEventFilter(_previousFilter, _previousFilterData);
+
     TTF_Quit();
     IMG_Quit();
     SDL_Quit();
@@ -45,18 +103,315 @@ void Box::setCursor(Cursor& cursor)
 
 void Box::update(float delta)
 {
+    GX_TRACE_ZONE("Box::update");
+    _frameArena.reset();
     for (const auto& widget : _widgets) {
         widget->update(delta);
     }
 }
 
-void Box::present()
+bool Box::present()
 {
-    _renderer.clear();
+    GX_TRACE_ZONE("Box::present");
+    layout();
+
+    bool presented = _renderer.visible() && presentDamage();
+    if (presented) {
+        _latency.markPresent();
+    }
+    // Present may run again without an update in between
+    _frameArena.reset();
+    return presented;
+}
+
+void Box::invalidate()
+{
+    _fullRedraw = true;
+}
+
+bool Box::presentDamage()
+{
+    auto windowSize = PixelVector{
+        (int)_renderer.windowSize().x, (int)_renderer.windowSize().y};
+    auto damage = Damage{windowSize, fullRedrawShare, &_frameArena};
+    if (_fullRedraw) {
+        damage.addAll();
+        _fullRedraw = false;
+    }
     for (const auto& widget : _widgets) {
-        widget->render(_renderer, _renderer.windowArea());
+        if (!widget->retained()) {
+            widget->damage(damage);
+        }
+    }
+    renderUiLayer(damage);
+
+    if (damage.empty()) {
+        return false;
+    }
+
+    if (damage.full() || !_renderer.dirtyRectangles()) {
+        _renderer.clear();
+        renderWidgets();
+        _renderer.present();
+        return true;
+    }
+
+    for (const auto& area : damage.areas()) {
+        auto screenArea = ScreenRectangle{
+            (float)area.x, (float)area.y, (float)area.w, (float)area.h};
+        _renderer.setClip(screenArea);
+        _renderer.drawRectangle(screenArea, {0, 0, 0, 255});
+        renderWidgets();
+    }
+    _renderer.setClip(std::nullopt);
+    _renderer.present(damage.areas());
+    return true;
+}
+
+void Box::renderWidgets()
+{
+    for (const auto& widget : _widgets) {
+        if (!widget->retained()) {
+            widget->render(_renderer);
+        }
+    }
+
+    if (_uiLayerSize.x > 0 && _uiLayerSize.y > 0) {
+        _renderer.draw(
+            _uiLayer,
+            {0, 0, _uiLayerSize.x, _uiLayerSize.y},
+            _renderer.windowArea().middlePoint());
     }
-    _renderer.present();
+}
+
+void Box::run(const Loop& loop)
+{
+    if (loop.pipelined) {
+        if (loop.recorder || loop.player) {
+            throw Error{"replays need a serial loop"};
+        }
+        runPipelined(loop);
+    } else {
+        runSerial(loop);
+    }
+}
+
+void Box::runSerial(const Loop& loop)
+{
+    auto clock = FrameClock{loop.rate, loop.maxCatchUpSteps};
+    auto predictor = PresentPredictor{_renderer.refreshRate()};
+    _recorder = loop.recorder;
+
+    while (_alive) {
+        if (loop.player && !loop.player->next()) {
+            break;
+        }
+
+        if (!loop.latchInput) {
+            input(loop);
+            if (!_alive) {
+                break;
+            }
+        }
+
+        int steps = loop.player ? loop.player->frame().steps : clock.advance();
+        for (int i = 0; i < steps; i++) {
+            GX_TRACE_ZONE("Loop::onStep");
+            loop.onStep(clock.delta());
+        }
+
+        if (loop.latchInput) {
+            if (!loop.player) {
+                waitUntil(
+                    predictor.latchDeadline(loop.latchMarginSeconds),
+                    loop.spinSeconds);
+            }
+            predictor.markLatch();
+            input(loop);
+            if (!_alive) {
+                break;
+            }
+        }
+
+        if (_recorder) {
+            _recorder->frame(steps);
+        }
+
+        {
+            GX_TRACE_ZONE("Loop::onFrame");
+            loop.onFrame(clock.alpha());
+        }
+        update(clock.delta() * (float)steps);
+        bool presented = present();
+        if (presented) {
+            predictor.markPresent();
+        }
+        GX_TRACE_FRAME();
+
+        clock.markFrame();
+        _pacingStats = clock.stats();
+
+        if (!presented && !loop.player) {
+            waitIdle(loop, clock);
+        } else if (loop.pace && !loop.latchInput && !loop.player) {
+            clock.waitForNextStep(loop.spinSeconds);
+        }
+    }
+
+    _recorder = nullptr;
+}
+
+void Box::waitIdle(const Loop& loop, const FrameClock& clock)
+{
+    // Vsync does not pace frames that were not presented
+    if (!loop.waitWhenIdle) {
+        clock.waitForNextStep(loop.spinSeconds);
+        return;
+    }
+    GX_TRACE_ZONE("Box::waitIdle");
+
+    // Nothing changes by itself in a window that is not shown. Otherwise
+    // wake up before more time passes than one frame catches up on, so that
+    // animations keep their pace.
+    auto timeout = -1;
+    if (_renderer.visible()) {
+        auto next = std::optional<float>{};
+        for (const auto& widget : _widgets) {
+            if (auto change = widget->nextChange()) {
+                next = std::min(next.value_or(*change), *change);
+            }
+        }
+        if (next) {
+            auto seconds = std::min(
+                *next, clock.delta() * (float)loop.maxCatchUpSteps);
+            timeout = std::max((int)std::ceil(seconds * 1000.f), 0);
+        }
+    }
+    SDL_WaitEventTimeout(nullptr, timeout);
+}
+
+void Box::input(const Loop& loop)
+{
+    if (!loop.player) {
+        pumpEvents(loop.onEvent);
+        return;
+    }
+
+    for (const auto& e : loop.player->frame().events) {
+        processEvent(e) || loop.onEvent(e);
+    }
+}
+
+void Box::runPipelined(const Loop& loop)
+{
+    auto simulatedWidgets = std::vector<Widget*>{};
+    auto otherWidgets = std::vector<Widget*>{};
+    // However the run ends, later serial runs read the widgets directly
+    // again instead of their last snapshots
+    auto pipelining = PipelineGuard{simulatedWidgets};
+    for (const auto& widget : _widgets) {
+        if (widget->simulated()) {
+            widget->pipeline(true);
+            simulatedWidgets.push_back(widget.get());
+        } else {
+            otherWidgets.push_back(widget.get());
+        }
+    }
+
+    auto simulationError = std::exception_ptr{};
+    auto simulation = std::thread{[&] {
+        try {
+            auto clock = FrameClock{loop.rate, loop.maxCatchUpSteps};
+            while (_alive) {
+                int steps = clock.advance();
+                for (int i = 0; i < steps; i++) {
+                    GX_TRACE_ZONE("Loop::onStep");
+                    loop.onStep(clock.delta());
+                }
+                {
+                    GX_TRACE_ZONE("Loop::onFrame");
+                    loop.onFrame(clock.alpha());
+                }
+
+                {
+                    GX_TRACE_ZONE("Box::update simulated");
+                    for (auto* widget : simulatedWidgets) {
+                        widget->update(clock.delta() * (float)steps);
+                    }
+                }
+
+                clock.waitForNextStep(loop.spinSeconds);
+            }
+        } catch (...) {
+            simulationError = std::current_exception();
+            _alive = false;
+        }
+    }};
+
+    // Rendering keeps the same pace, unless vsync is trusted to do it
+    auto clock = FrameClock{loop.rate, loop.maxCatchUpSteps};
+    auto predictor = PresentPredictor{_renderer.refreshRate()};
+    try {
+        while (_alive) {
+            if (loop.latchInput) {
+                waitUntil(
+                    predictor.latchDeadline(loop.latchMarginSeconds),
+                    loop.spinSeconds);
+                predictor.markLatch();
+            }
+            pumpEvents(loop.onEvent);
+            if (!_alive) {
+                break;
+            }
+
+            int steps = clock.advance();
+            _frameArena.reset();
+            {
+                GX_TRACE_ZONE("Box::update");
+                for (auto* widget : otherWidgets) {
+                    widget->update(clock.delta() * (float)steps);
+                }
+            }
+            bool presented = present();
+            if (presented) {
+                predictor.markPresent();
+            }
+            GX_TRACE_FRAME();
+
+            clock.markFrame();
+            _pacingStats = clock.stats();
+
+            // Vsync does not pace frames that were not presented
+            if (!presented || (loop.pace && !loop.latchInput)) {
+                clock.waitForNextStep(loop.spinSeconds);
+            }
+        }
+    } catch (...) {
+        _alive = false;
+        simulation.join();
+        throw;
+    }
+
+    simulation.join();
+
+    if (simulationError) {
+        std::rethrow_exception(simulationError);
+    }
+}
+
+void Box::stop()
+{
+    _alive = false;
+}
+
+const PacingStats& Box::pacingStats() const
+{
+    return _pacingStats;
+}
+
+LatencyStats Box::latencyStats() const
+{
+    return _latency.stats();
 }
 
 bool Box::alive() const
@@ -74,6 +429,73 @@ Renderer& Box::renderer()
     return _renderer;
 }
 
+FrameArena& Box::frameArena()
+{
+    return _frameArena;
+}
+
+void Box::pumpEvents(const std::function<bool(const SDL_Event&)>& handler)
+{
+    GX_TRACE_ZONE("Box::pumpEvents");
+    auto dispatch = [this, &handler] (const SDL_Event& e) {
+        if (_recorder) {
+            _recorder->event(e);
+        }
+        processEvent(e) || handler(e);
+    };
+
+    auto motion = SDL_Event{};
+    bool motionPending = false;
+
+    for (SDL_Event e; SDL_PollEvent(&e); ) {
+        _latency.markInput(e);
+
+        if (e.type == SDL_MOUSEMOTION) {
+            if (motionPending &&
+                    motion.motion.windowID == e.motion.windowID &&
+                    motion.motion.which == e.motion.which) {
+                e.motion.xrel += motion.motion.xrel;
+                e.motion.yrel += motion.motion.yrel;
+            } else if (motionPending) {
+                dispatch(motion);
+            }
+            motion = e;
+            motionPending = true;
+            continue;
+        }
+
+        if (motionPending) {
+            dispatch(motion);
+            motionPending = false;
+        }
+        dispatch(e);
+    }
+
+    if (motionPending) {
+        dispatch(motion);
+    }
+}
+
+void Box::acceptEvent(Uint32 type)
+{
+    if (type < _droppedEvents.size()) {
+        _droppedEvents[type].store(false, std::memory_order_relaxed);
+    }
+}
+
+int Box::filterEvent(void* userdata, SDL_Event* e)
+{
+    const auto* box = static_cast<const Box*>(userdata);
+    if (e->type < box->_droppedEvents.size() &&
+            box->_droppedEvents[e->type].load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    if (box->_previousFilter) {
+        return box->_previousFilter(box->_previousFilterData, e);
+    }
+    return 1;
+}
+
 bool Box::processEvent(const SDL_Event& e)
 {
     if (e.type == SDL_QUIT) {
@@ -85,25 +507,120 @@ bool Box::processEvent(const SDL_Event& e)
         return true;
     }
 
-    processUiEvent(e) || _renderer.processEvent(e);
+    if (e.type == SDL_RENDER_TARGETS_RESET ||
+            e.type == SDL_RENDER_DEVICE_RESET) {
+        // Render target contents are lost
+        _uiLayerSize = {};
+        _dirty.render = true;
+        _fullRedraw = true;
+        _renderer.processEvent(e);
+        return false;
+    }
+
+    // The window may not show the last frame any more
+    if (e.type == SDL_WINDOWEVENT && (
+            e.window.event == SDL_WINDOWEVENT_EXPOSED ||
+            e.window.event == SDL_WINDOWEVENT_SHOWN ||
+            e.window.event == SDL_WINDOWEVENT_RESTORED)) {
+        _fullRedraw = true;
+    }
+
+    if (!processUiEvent(e) && _renderer.processEvent(e)) {
+        _dirty.layout = true;
+        _dirty.render = true;
+        _fullRedraw = true;
+    }
 
     return false;
 }
 
-Widget* Box::widgetAtPosition(int x, int y) const
+void Box::layout()
+{
+    if (!_dirty.layout) {
+        return;
+    }
+    GX_TRACE_ZONE("Box::layout");
+
+    auto windowArea = _renderer.windowArea();
+    _hitGrid.reset(windowArea);
+    for (size_t i = 0; i < _widgets.size(); i++) {
+        _widgets.at(i)->layout(windowArea);
+        if (auto area = _widgets.at(i)->hitArea()) {
+            _hitGrid.insert(i, *area);
+        }
+    }
+    _dirty.layout = false;
+}
+
+void Box::renderUiLayer(Damage& screenDamage)
 {
-    const auto& windowArea = _renderer.windowArea();
-    auto point = ScreenPoint{(float)x, (float)y};
-    for (const auto& widget : _widgets | std::views::reverse) {
-        if (auto* target = widget->locate(windowArea, point)) {
-            return target;
+    if (!_dirty.render) {
+        return;
+    }
+    _dirty.render = false;
+    GX_TRACE_ZONE("Box::renderUiLayer");
+
+    if (std::ranges::none_of(_widgets, &Widget::retained)) {
+        _uiLayerSize = {};
+        return;
+    }
+
+    auto damage = std::pmr::vector<ScreenRectangle>{&_frameArena};
+
+    auto windowSize = PixelVector{
+        (int)_renderer.windowSize().x, (int)_renderer.windowSize().y};
+    if (windowSize != _uiLayerSize) {
+        _uiLayerSize = windowSize;
+        if (_uiLayerSize.x <= 0 || _uiLayerSize.y <= 0) {
+            return;
+        }
+        _uiLayer = _renderer.createTarget(_uiLayerSize);
+        damage.push_back(_renderer.windowArea());
+    }
+
+    for (const auto& widget : _widgets) {
+        if (!widget->retained() || !widget->_renderDirty) {
+            continue;
         }
+        widget->_renderDirty = false;
+
+        if (widget->_renderedArea) {
+            damage.push_back(*widget->_renderedArea);
+        }
+        widget->_renderedArea = widget->renderArea();
+        damage.push_back(*widget->_renderedArea);
+    }
+
+    for (const auto& area : damage) {
+        screenDamage.add(area);
     }
-    return nullptr;
+
+    // Redraw everything that overlaps a damaged area, in the original order
+    _renderer.setTarget(&_uiLayer);
+    for (const auto& area : damage) {
+        _renderer.setClip(area);
+        _renderer.erase(area);
+        for (const auto& widget : _widgets) {
+            if (widget->retained() && widget->_renderedArea &&
+                    intersects(*widget->_renderedArea, area)) {
+                widget->render(_renderer);
+            }
+        }
+    }
+    _renderer.setClip(std::nullopt);
+    _renderer.setTarget(nullptr);
+}
+
+Widget* Box::widgetAtPosition(int x, int y)
+{
+    layout();
+    auto index = _hitGrid.find(ScreenPoint{(float)x, (float)y});
+    return index ? _widgets.at(*index).get() : nullptr;
 }
 
 bool Box::processUiEvent(const SDL_Event& e)
 {
+    GX_TRACE_ZONE("Box::processUiEvent");
     auto windowArea = _renderer.windowArea();
 
     if (e.type == SDL_MOUSEMOTION) {
@@ -0,0 +1,266 @@
+#include <gx/capture.hpp>
+
+#include <gx/error.hpp>
+#include <gx/trace.hpp>
+
+#include <SDL_image.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace gx {
+
+namespace {
+
+double secondsSince(Uint64 start)
+{
+    return (double)(SDL_GetPerformanceCounter() - start) /
+        (double)SDL_GetPerformanceFrequency();
+}
+
+// BT.601 with video range, what Y4M readers assume without a color tag
+std::uint8_t luma(int r, int g, int b)
+{
+    return (std::uint8_t)(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+}
+
+std::uint8_t blueDifference(int r, int g, int b)
+{
+    return (std::uint8_t)(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+}
+
+std::uint8_t redDifference(int r, int g, int b)
+{
+    return (std::uint8_t)(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+}
+
+} // namespace
+
+FrameCapture::FrameCapture(const CaptureConfig& config)
+    : _config(config)
+{
+    if (_config.queueDepth == 0) {
+        throw Error{"capture queue needs at least one frame"};
+    }
+    if (_config.format == CaptureFormat::PngSequence) {
+        std::filesystem::create_directories(_config.path);
+    } else {
+        _stream.open(_config.path, std::ios::binary);
+        if (!_stream) {
+            throw Error{"cannot write capture " + _config.path.string()};
+        }
+    }
+
+    _frames.resize(_config.queueDepth);
+    for (size_t i = 0; i < _frames.size(); i++) {
+        _free.push_back(i);
+    }
+    _encoder = std::thread{[this] { work(); }};
+}
+
+FrameCapture::~FrameCapture()
+{
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _stopping = true;
+    }
+    _queuedChanged.notify_all();
+    if (_encoder.joinable()) {
+        _encoder.join();
+    }
+}
+
+bool FrameCapture::capture(
+    const PixelVector& size,
+    const std::function<void(std::uint32_t* pixels, int pitch)>& read)
+{
+    GX_TRACE_ZONE("FrameCapture::capture");
+    auto start = SDL_GetPerformanceCounter();
+    auto index = _nextIndex++;
+
+    // Y4M streams cannot change size midway
+    bool fits = size.x > 0 && size.y > 0 &&
+        (_config.format != CaptureFormat::Y4m ||
+            _streamSize == PixelVector{} || size == _streamSize);
+
+    auto slot = std::optional<size_t>{};
+    {
+        auto lock = std::scoped_lock{_mutex};
+        if (fits && !_stopping && !_error && !_free.empty()) {
+            slot = _free.back();
+            _free.pop_back();
+        } else {
+            _stats.dropped++;
+            auto seconds = secondsSince(start);
+            _captureSeconds += seconds;
+            _stats.maxCaptureSeconds =
+                std::max(_stats.maxCaptureSeconds, seconds);
+            return false;
+        }
+    }
+
+    // The buffer belongs to this thread until it is queued
+    auto& frame = _frames[*slot];
+    frame.index = index;
+    frame.size = size;
+    frame.pixels.resize((size_t)size.x * size.y);
+    try {
+        read(frame.pixels.data(), size.x * (int)sizeof(std::uint32_t));
+    } catch (...) {
+        auto lock = std::scoped_lock{_mutex};
+        _free.push_back(*slot);
+        throw;
+    }
+    if (_config.format == CaptureFormat::Y4m) {
+        _streamSize = size;
+    }
+
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _queued.push_back(*slot);
+        _stats.captured++;
+        auto seconds = secondsSince(start);
+        _captureSeconds += seconds;
+        _stats.maxCaptureSeconds =
+            std::max(_stats.maxCaptureSeconds, seconds);
+    }
+    _queuedChanged.notify_one();
+    return true;
+}
+
+void FrameCapture::stop()
+{
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _stopping = true;
+    }
+    _queuedChanged.notify_all();
+    if (_encoder.joinable()) {
+        _encoder.join();
+    }
+
+    if (auto error = std::exchange(_error, nullptr)) {
+        std::rethrow_exception(error);
+    }
+}
+
+bool FrameCapture::running() const
+{
+    auto lock = std::scoped_lock{_mutex};
+    return !_stopping && !_error;
+}
+
+CaptureStats FrameCapture::stats() const
+{
+    auto lock = std::scoped_lock{_mutex};
+    auto stats = _stats;
+    if (auto frames = stats.captured + stats.dropped; frames > 0) {
+        stats.meanCaptureSeconds = _captureSeconds / (double)frames;
+    }
+    if (stats.written > 0) {
+        stats.meanEncodeSeconds = _encodeSeconds / (double)stats.written;
+    }
+    return stats;
+}
+
+void FrameCapture::work()
+{
+    auto lock = std::unique_lock{_mutex};
+    while (true) {
+        // Frames queued before stopping are still written
+        _queuedChanged.wait(
+            lock, [this] { return _stopping || !_queued.empty(); });
+        if (_queued.empty()) {
+            return;
+        }
+        auto slot = _queued.front();
+        _queued.pop_front();
+        lock.unlock();
+
+        auto start = SDL_GetPerformanceCounter();
+        try {
+            encode(_frames[slot]);
+        } catch (...) {
+            lock.lock();
+            _error = std::current_exception();
+            _queued.clear();
+            return;
+        }
+        auto seconds = secondsSince(start);
+
+        lock.lock();
+        _free.push_back(slot);
+        _stats.written++;
+        _encodeSeconds += seconds;
+    }
+}
+
+void FrameCapture::encode(const Frame& frame)
+{
+    GX_TRACE_ZONE("FrameCapture::encode");
+    if (_config.format == CaptureFormat::PngSequence) {
+        writePng(frame);
+    } else {
+        writeY4m(frame);
+    }
+}
+
+void FrameCapture::writePng(const Frame& frame)
+{
+    char name[32];
+    std::snprintf(
+        name,
+        sizeof(name),
+        "frame-%06llu.png",
+        (unsigned long long)frame.index);
+    auto path = _config.path / name;
+
+    // Frames are opaque; saving them without alpha keeps the files smaller
+    auto surface = std::unique_ptr<SDL_Surface, void(*)(SDL_Surface*)>{
+        sdlCheck(SDL_CreateRGBSurfaceWithFormatFrom(
+            (void*)frame.pixels.data(),
+            frame.size.x,
+            frame.size.y,
+            32,
+            frame.size.x * (int)sizeof(std::uint32_t),
+            SDL_PIXELFORMAT_RGB888)),
+        SDL_FreeSurface};
+    sdlCheck(IMG_SavePNG(surface.get(), path.string().c_str()));
+}
+
+void FrameCapture::writeY4m(const Frame& frame)
+{
+    if (!_streamStarted) {
+        _stream << "YUV4MPEG2 W" << frame.size.x << " H" << frame.size.y
+            << " F" << _config.rate << ":1 Ip A1:1 C444\n";
+        _streamStarted = true;
+    }
+
+    auto pixelCount = (size_t)frame.size.x * frame.size.y;
+    _planes.resize(pixelCount * 3);
+    auto* y = _planes.data();
+    auto* u = y + pixelCount;
+    auto* v = u + pixelCount;
+    for (size_t i = 0; i < pixelCount; i++) {
+        auto pixel = frame.pixels[i];
+        int r = (pixel >> 16) & 0xFF;
+        int g = (pixel >> 8) & 0xFF;
+        int b = pixel & 0xFF;
+        y[i] = luma(r, g, b);
+        u[i] = blueDifference(r, g, b);
+        v[i] = redDifference(r, g, b);
+    }
+
+    _stream << "FRAME\n";
+    _stream.write(
+        reinterpret_cast<const char*>(_planes.data()),
+        (std::streamsize)_planes.size());
+    if (!_stream) {
+        throw Error{"cannot write capture " + _config.path.string()};
+    }
+}
+
+} // namespace gx
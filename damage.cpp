@@ -0,0 +1,98 @@
+#include <gx/damage.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace gx {
+
+namespace {
+
+// Beyond this, drawing each area costs more than it saves
+constexpr size_t maxAreas = 32;
+
+std::int64_t pixelCount(const PixelRectangle& area)
+{
+    return (std::int64_t)area.w * area.h;
+}
+
+PixelRectangle boundingBox(const PixelRectangle& lhs, const PixelRectangle& rhs)
+{
+    auto left = std::min(lhs.x, rhs.x);
+    auto top = std::min(lhs.y, rhs.y);
+    auto right = std::max(lhs.x + lhs.w, rhs.x + rhs.w);
+    auto bottom = std::max(lhs.y + lhs.h, rhs.y + rhs.h);
+    return {left, top, right - left, bottom - top};
+}
+
+} // namespace
+
+Damage::Damage(
+    const PixelVector& screenSize,
+    float fullShare,
+    std::pmr::memory_resource* memory)
+    : _screenSize(screenSize)
+    , _fullArea((std::int64_t)std::floor(
+        fullShare * (float)screenSize.x * (float)screenSize.y))
+    , _areas(memory)
+{ }
+
+void Damage::add(const ScreenRectangle& area)
+{
+    if (_full) {
+        return;
+    }
+
+    // Whole pixels touched by the area, inside the screen
+    auto left = std::max((int)std::floor(area.x), 0);
+    auto top = std::max((int)std::floor(area.y), 0);
+    auto right = std::min((int)std::ceil(area.x + area.w), _screenSize.x);
+    auto bottom = std::min((int)std::ceil(area.y + area.h), _screenSize.y);
+    if (left >= right || top >= bottom) {
+        return;
+    }
+    auto added = PixelRectangle{left, top, right - left, bottom - top};
+
+    // Merging can make the box overlap areas it did not overlap before, so
+    // keep going until it overlaps none
+    for (size_t i = 0; i < _areas.size(); ) {
+        if (intersects(_areas[i], added)) {
+            added = boundingBox(_areas[i], added);
+            _area -= pixelCount(_areas[i]);
+            _areas[i] = _areas.back();
+            _areas.pop_back();
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    _areas.push_back(added);
+    _area += pixelCount(added);
+
+    if (_area > _fullArea || _areas.size() > maxAreas) {
+        addAll();
+    }
+}
+
+void Damage::addAll()
+{
+    _full = true;
+    _areas.assign({PixelRectangle{0, 0, _screenSize.x, _screenSize.y}});
+    _area = pixelCount(_areas.front());
+}
+
+bool Damage::empty() const
+{
+    return _areas.empty();
+}
+
+bool Damage::full() const
+{
+    return _full;
+}
+
+const std::pmr::vector<PixelRectangle>& Damage::areas() const
+{
+    return _areas;
+}
+
+} // namespace gx
@@ -3,11 +3,12 @@
 #include <SDL.h>
 
 #include <algorithm>
-#include <chrono>
 #include <filesystem>
 #include <map>
 #include <ostream>
-#include <thread>
+#include <span>
+#include <string_view>
+#include <vector>
 
 #include <iostream>
 
@@ -161,18 +162,19 @@ struct Bullet {
     float age = 0.f;
 };
 
-struct Message {
-    size_t objectId = 0;
-    ObjectType type = ObjectType::None;
-    bool alive = true;
-    float x = 0.f;
-    float y = 0.f;
-};
+// Filled by the simulation, drained by the scene once per frame
+gx::SceneCommandQueue sceneCommands{4096};
 
-// Poor man's event queue
-std::vector<Message> messages;
+using Broadphase = gx::Broadphase<float, gx::WorldTag>;
+
+constexpr gx::WorldPoint worldPoint(const Vector& vector)
+{
+    return {vector.x, vector.y};
+}
 
 struct World {
+    static constexpr float bulletHitDistance = 0.6f;
+
     void initialize()
     {
         constexpr auto G = ObjectType::Grass;
@@ -207,16 +209,22 @@ struct World {
                         .position = {x, y}
                     };
                     objects.push_back(object);
-                    messages.push_back(Message{
-                        .objectId = object.id,
-                        .type = object.type,
-                        .x = object.position.x,
-                        .y = object.position.y,
+                    pendingCommands.push_back(gx::SceneCommand{
+                        .type = gx::SceneCommand::Type::Spawn,
+                        .key = object.id,
+                        .sprite = sprites.at(object.type),
+                        .position = worldPoint(object.position),
                     });
+                    obstacles.insert(
+                        gx::Id{object.id},
+                        gx::Circle<float, gx::WorldTag>{
+                            .center = worldPoint(object.position),
+                            .radius = bulletHitDistance,
+                        });
                 }
             }
         }
-
+        flushCommands();
     }
 
     void update(float delta)
@@ -248,36 +256,66 @@ struct World {
 
         for (size_t i = 0; i < bullets.size(); ) {
             auto& bullet = bullets.at(i);
-            bullet.position += bullet.velocity * delta;
-            bullet.age += delta;
-            messages.push_back(Message{
-                .objectId = bullet.id,
-                .x = bullet.position.x,
-                .y = bullet.position.y});
-
-            bool collision = false;
-            for (size_t j = 0; j < objects.size(); ) {
-                auto& object = objects.at(j);
-                if (distance(bullet.position, object.position) < 0.6f) {
-                    collision = true;
-                    messages.push_back(Message{
-                        .objectId = object.id, .alive = false});
-                    std::swap(object, objects.back());
-                    objects.resize(objects.size() - 1);
-                } else {
-                    j++;
-                }
+            auto motion = bullet.velocity * delta;
+
+            // Sweep the whole step, so that fast bullets cannot tunnel
+            auto hit = obstacles.segment(
+                worldPoint(bullet.position),
+                worldPoint(bullet.position + motion));
+            if (hit) {
+                bullet.position += motion * hit->time;
+                killObject(hit->id);
+            } else {
+                bullet.position += motion;
             }
+            bullet.age += delta;
+            pendingCommands.push_back(gx::SceneCommand{
+                .type = gx::SceneCommand::Type::Move,
+                .key = bullet.id,
+                .position = worldPoint(bullet.position),
+            });
 
-            if (collision || bullet.age > 1.f) {
-                messages.push_back(
-                    Message{.objectId = bullet.id, .alive = false});
+            if (hit || bullet.age > 1.f) {
+                pendingCommands.push_back(gx::SceneCommand{
+                    .type = gx::SceneCommand::Type::Kill,
+                    .key = bullet.id,
+                });
                 std::swap(bullet, bullets.back());
                 bullets.resize(bullets.size() - 1);
             } else {
                 i++;
             }
         }
+
+        flushCommands();
+    }
+
+    // Publishes the commands of a whole step at once. If the scene fell
+    // behind, the ones that did not fit are kept and retried with the next
+    // step.
+    void flushCommands()
+    {
+        auto published =
+            sceneCommands.pushBatches(std::span{pendingCommands});
+        pendingCommands.erase(
+            pendingCommands.begin(),
+            pendingCommands.begin() + (std::ptrdiff_t)published);
+    }
+
+    void killObject(size_t id)
+    {
+        auto it = std::ranges::find(objects, id, &Object::id);
+        if (it == objects.end()) {
+            return;
+        }
+
+        obstacles.erase(gx::Id{id});
+        pendingCommands.push_back(gx::SceneCommand{
+            .type = gx::SceneCommand::Type::Kill,
+            .key = id,
+        });
+        std::swap(*it, objects.back());
+        objects.resize(objects.size() - 1);
     }
 
     Vector controlVector() const
@@ -332,11 +370,11 @@ struct World {
                 .id = nextId++,
                 .position = heroPosition,
                 .velocity = bulletVelocity});
-            messages.push_back(Message{
-                .objectId = bullets.back().id,
-                .type = ObjectType::Bullet,
-                .x = bullets.back().position.x,
-                .y = bullets.back().position.y,
+            pendingCommands.push_back(gx::SceneCommand{
+                .type = gx::SceneCommand::Type::Spawn,
+                .key = bullets.back().id,
+                .sprite = sprites.at(ObjectType::Bullet),
+                .position = worldPoint(heroPosition),
             });
         }
     }
@@ -346,7 +384,10 @@ struct World {
     KeyboardControl control;
     std::vector<Object> objects;
     std::vector<Bullet> bullets;
+    Broadphase obstacles;
     size_t nextId = 0;
+    std::map<ObjectType, const gx::Sprite*> sprites;
+    std::vector<gx::SceneCommand> pendingCommands;
 };
 
 struct Client {
@@ -428,56 +469,22 @@ Resources loadResources(gx::Box& box)
     return r;
 }
 
-class Timer {
-    using Clock = std::chrono::high_resolution_clock;
-
-public:
-    Timer(int fps)
-        : _delta(1.f / (float)fps)
-        , _frameDuration(std::chrono::duration_cast<Clock::duration>(
-            std::chrono::duration<float>(_delta)))
-        , _start(Clock::now())
-    { }
-
-    float delta() const
-    {
-        return _delta;
-    }
-
-    int operator()()
-    {
-        auto now = Clock::now();
-        size_t frame = (now - _start) / _frameDuration;
-        int framesPassed = static_cast<int>(frame - _lastFrame);
-        _lastFrame = frame;
-        return framesPassed;
-    }
-
-    void relax() const
-    {
-        std::this_thread::sleep_until(
-            _start + _frameDuration * (_lastFrame + 1));
-    }
-
-private:
-    float _delta = 0.f;
-    Clock::duration _frameDuration;
-    Clock::time_point _start;
-    size_t _lastFrame = 0;
-};
-
-int main()
+int main(int argc, char* argv[])
 {
-    auto world = World{};
-    world.initialize();
-
     auto box = gx::Box{};
     auto r = loadResources(box);
     gx::Box::setCursor(r.cursor);
 
-    auto* scene = box.createWidget<gx::Scene>();
+    auto world = World{};
+    world.sprites = {
+        {ObjectType::Tree, &r.sprites.tree},
+        {ObjectType::Stone, &r.sprites.stone},
+        {ObjectType::Bullet, &r.sprites.bullet},
+    };
+    world.pendingCommands.reserve(sceneCommands.capacity());
+    world.initialize();
 
-    bool quitRequested = false;
+    auto* scene = box.createWidget<gx::Scene>();
 
     box.createWidget<gx::Button>()
         ->position(1_fr - 20_px - 32_px * 3, 20_px + 8_px * 3)
@@ -485,78 +492,48 @@ int main()
         ->buttonSprite(r.sprites.buttonNormal)
         ->pressedButtonSprite(r.sprites.buttonPressed)
         ->textSprite(r.sprites.quitTextSprite)
-        ->action([&quitRequested] { quitRequested = true; });
-
-    std::map<size_t, gx::Object*> objects;
+        ->action([&box] { box.stop(); });
 
     auto* hero = scene->spawn(r.sprites.hero, gx::WorldPoint{0, 0});
     scene->setupCamera(gx::WorldPoint{0, 0}, 16, 4);
+    scene->lowResolution(true);
     scene->cameraFollow(hero);
     scene->clickAction([&world] (const gx::WorldPoint& point) {
         world.shootInDirectionOf({point.x, point.y});
     });
 
-    static constexpr int fps = 60;
-    auto timer = Timer{fps};
-
-    for (;;) {
-        for (SDL_Event e; SDL_PollEvent(&e); ) {
-            box.processEvent(e) || world.processEvent(e);
-        }
-        if (box.dead() || quitRequested) {
-            break;
-        }
+    auto loop = gx::Loop{
+        .rate = 60,
+        .onEvent = [&world] (const SDL_Event& e) {
+            return world.processEvent(e);
+        },
+        // Update world with the same delta for perfect reproducibility
+        .onStep = [&world] (float delta) {
+            world.update(delta);
+        },
+    };
 
-        if (int framesPassed = timer(); framesPassed > 0) {
-            // Update world with the same delta for perfect reproducibility
-            for (int i = 0; i < framesPassed; i++) {
-                world.update((float)timer.delta());
-            }
+    loop.onFrame = [&] (float) {
+        scene->apply(sceneCommands);
+        hero->position = {world.heroPosition.x, world.heroPosition.y};
+    };
 
-            for (const auto& message : messages) {
-                if (auto it = objects.find(message.objectId);
-                        it != objects.end()) {
-                    auto* object = it->second;
-                    if (!message.alive) {
-                        object->kill = true;
-                        objects.erase(it);
-                    } else {
-                        object->position = {message.x, message.y};
-                    }
-                } else {
-                    gx::Sprite* sprite = nullptr;
-                    switch (message.type) {
-                        case ObjectType::Stone:
-                            sprite = &r.sprites.stone;
-                            break;
-                        case ObjectType::Tree:
-                            sprite = &r.sprites.tree;
-                            break;
-                        case ObjectType::Hero:
-                            sprite = &r.sprites.hero;
-                            break;
-                        case ObjectType::Bullet:
-                            sprite = &r.sprites.bullet;
-                            break;
-                        default:
-                            break;
-                    }
-
-                    if (sprite) {
-                        auto* object = scene->spawn(
-                            *sprite, {message.x, message.y});
-                        objects.emplace(message.objectId, object);
-                    }
-                }
-            }
-            messages.clear();
+    // Compare the latency reported on exit with and without latching
+    loop.latchInput =
+        argc > 1 && std::string_view{argv[1]} == "--latch-input";
 
-            hero->position = {world.heroPosition.x, world.heroPosition.y};
+    box.run(loop);
 
-            box.update(timer.delta() * (float)framesPassed);
-            box.present();
-        }
+    auto stats = sceneCommands.stats();
+    std::cout << "scene commands: " << stats.published << " published, " <<
+        stats.rejected << " rejected, " << stats.highWater <<
+        " max waiting\n";
 
-        timer.relax();
-    }
+    auto latency = box.latencyStats();
+    std::cout << "input latency over " << latency.samples << " events: " <<
+        "mean " << latency.meanSeconds * 1000 << " ms, " <<
+        "p50 " << latency.p50Seconds * 1000 << " ms, " <<
+        "p95 " << latency.p95Seconds * 1000 << " ms, " <<
+        "p99 " << latency.p99Seconds * 1000 << " ms, " <<
+        "max " << latency.maxSeconds * 1000 << " ms\n";
 }
@@ -0,0 +1,91 @@
+#include <gx/frame_arena.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+namespace gx {
+
+namespace {
+
+[[maybe_unused]] constexpr unsigned char poison = 0xDD;
+
+void poisonMemory([[maybe_unused]] void* p, [[maybe_unused]] size_t bytes)
+{
+#ifndef NDEBUG
+    std::memset(p, poison, bytes);
+#endif
+}
+
+size_t alignedOffset(const std::byte* base, size_t offset, size_t alignment)
+{
+    auto address = reinterpret_cast<std::uintptr_t>(base) + offset;
+    auto mask = (std::uintptr_t)(alignment - 1);
+    auto aligned = (address + mask) & ~mask;
+    return offset + (size_t)(aligned - address);
+}
+
+} // namespace
+
+FrameArena::FrameArena(size_t capacity)
+    : _block(std::make_unique<std::byte[]>(capacity))
+{
+    _stats.capacity = capacity;
+    poisonMemory(_block.get(), capacity);
+}
+
+void FrameArena::reset()
+{
+    if (!_overflowBlocks.empty()) {
+        // Regrow to fit the largest frame seen so far in one block
+        _overflowBlocks.clear();
+        _stats.capacity = std::bit_ceil(_stats.highWater);
+        _block = std::make_unique<std::byte[]>(_stats.capacity);
+        poisonMemory(_block.get(), _stats.capacity);
+    } else {
+        poisonMemory(_block.get(), _offset);
+    }
+
+    _offset = 0;
+    _stats.used = 0;
+}
+
+const ArenaStats& FrameArena::stats() const
+{
+    return _stats;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+    auto start = alignedOffset(_block.get(), _offset, alignment);
+    if (start + bytes <= _stats.capacity) {
+        _stats.used += start + bytes - _offset;
+        _stats.highWater = std::max(_stats.highWater, _stats.used);
+        _offset = start + bytes;
+        return _block.get() + start;
+    }
+
+    // Oversized blocks are allocated for every allocation that does not fit,
+    // until the next reset grows the main block
+    auto size = bytes + alignment;
+    auto& block =
+        _overflowBlocks.emplace_back(std::make_unique<std::byte[]>(size));
+    _stats.used += size;
+    _stats.highWater = std::max(_stats.highWater, _stats.used);
+    _stats.overflows++;
+    return block.get() + alignedOffset(block.get(), 0, alignment);
+}
+
+void FrameArena::do_deallocate(void* p, size_t bytes, size_t /*alignment*/)
+{
+    poisonMemory(p, bytes);
+}
+
+bool FrameArena::do_is_equal(
+    const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+} // namespace gx
@@ -0,0 +1,108 @@
+#include <gx/frame_clock.hpp>
+
+#include <gx/error.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace gx {
+
+void waitUntil(Uint64 deadline, float spinSeconds)
+{
+    auto frequency = SDL_GetPerformanceFrequency();
+    auto spinTicks = (Uint64)(spinSeconds * (float)frequency);
+
+    // SDL_Delay may oversleep by a millisecond or more, so it only covers
+    // the time up to the spin threshold
+    for (auto now = SDL_GetPerformanceCounter(); now < deadline;
+            now = SDL_GetPerformanceCounter()) {
+        auto remaining = deadline - now;
+        if (remaining <= spinTicks) {
+            continue;
+        }
+        auto sleepMs = (remaining - spinTicks) * 1000 / frequency;
+        if (sleepMs > 0) {
+            SDL_Delay((Uint32)sleepMs);
+        }
+    }
+}
+
+FrameClock::FrameClock(int rate, int maxSteps)
+    : _frequency(SDL_GetPerformanceFrequency())
+    , _maxSteps(maxSteps)
+    , _lastAdvance(SDL_GetPerformanceCounter())
+{
+    if (rate <= 0 || maxSteps <= 0) {
+        throw Error{
+            "invalid frame clock rate " + std::to_string(rate) +
+            " with " + std::to_string(maxSteps) + " steps"};
+    }
+    _stepTicks = _frequency / (Uint64)rate;
+}
+
+int FrameClock::advance()
+{
+    auto now = SDL_GetPerformanceCounter();
+    _accumulated += now - _lastAdvance;
+    _lastAdvance = now;
+
+    auto steps = _accumulated / _stepTicks;
+    if (steps > (Uint64)_maxSteps) {
+        // Drop the backlog instead of spiralling into ever more steps
+        _stats.droppedSteps += steps - (Uint64)_maxSteps;
+        steps = (Uint64)_maxSteps;
+        _accumulated %= _stepTicks;
+    } else {
+        _accumulated -= steps * _stepTicks;
+    }
+    return (int)steps;
+}
+
+float FrameClock::delta() const
+{
+    return (float)((double)_stepTicks / (double)_frequency);
+}
+
+float FrameClock::alpha() const
+{
+    return (float)((double)_accumulated / (double)_stepTicks);
+}
+
+void FrameClock::waitForNextStep(float spinSeconds) const
+{
+    waitUntil(_lastAdvance + (_stepTicks - _accumulated), spinSeconds);
+}
+
+void FrameClock::markFrame()
+{
+    auto now = SDL_GetPerformanceCounter();
+    if (_lastFrame == 0) {
+        _lastFrame = now;
+        return;
+    }
+
+    auto frameSeconds = (double)(now - _lastFrame) / (double)_frequency;
+    _lastFrame = now;
+
+    // Welford's running mean and variance
+    _stats.frames++;
+    auto previousMean = _stats.meanFrameSeconds;
+    _stats.meanFrameSeconds +=
+        (frameSeconds - previousMean) / (double)_stats.frames;
+    _frameSecondsM2 += (frameSeconds - previousMean) *
+        (frameSeconds - _stats.meanFrameSeconds);
+    _stats.jitterSeconds =
+        std::sqrt(_frameSecondsM2 / (double)_stats.frames);
+
+    _stats.maxDeviationSeconds = std::max(
+        _stats.maxDeviationSeconds,
+        std::abs(frameSeconds - (double)delta()));
+}
+
+const PacingStats& FrameClock::stats() const
+{
+    return _stats;
+}
+
+} // namespace gx
@@ -0,0 +1,66 @@
+#include <gx/hit_grid.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <ranges>
+
+namespace gx {
+
+void HitGrid::reset(const ScreenRectangle& bounds)
+{
+    _bounds = bounds;
+    _columns = std::max(1, (int)std::ceil(bounds.w / cellSize));
+    _rows = std::max(1, (int)std::ceil(bounds.h / cellSize));
+
+    _cells.resize((size_t)_columns * (size_t)_rows);
+    for (auto& cell : _cells) {
+        cell.clear();
+    }
+}
+
+void HitGrid::insert(size_t index, const ScreenRectangle& area)
+{
+    if (area.x > _bounds.x + _bounds.w || area.x + area.w < _bounds.x ||
+            area.y > _bounds.y + _bounds.h || area.y + area.h < _bounds.y) {
+        return;
+    }
+
+    auto lastColumn = column(area.x + area.w);
+    auto lastRow = row(area.y + area.h);
+    for (int r = row(area.y); r <= lastRow; r++) {
+        for (int c = column(area.x); c <= lastColumn; c++) {
+            _cells.at((size_t)(r * _columns + c)).push_back(
+                Entry{.index = index, .area = area});
+        }
+    }
+}
+
+std::optional<size_t> HitGrid::find(const ScreenPoint& point) const
+{
+    if (!_bounds.contains(point)) {
+        return std::nullopt;
+    }
+
+    const auto& cell =
+        _cells.at((size_t)(row(point.y) * _columns + column(point.x)));
+    for (const auto& entry : cell | std::views::reverse) {
+        if (entry.area.contains(point)) {
+            return entry.index;
+        }
+    }
+    return std::nullopt;
+}
+
+int HitGrid::column(float x) const
+{
+    return std::clamp(
+        (int)std::floor((x - _bounds.x) / cellSize), 0, _columns - 1);
+}
+
+int HitGrid::row(float y) const
+{
+    return std::clamp(
+        (int)std::floor((y - _bounds.y) / cellSize), 0, _rows - 1);
+}
+
+} // namespace gx
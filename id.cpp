@@ -1,23 +1,256 @@
 #include <gx/id.hpp>
 
+#include <gx/error.hpp>
+
+#include <algorithm>
+#include <array>
+#include <string>
+
 namespace gx {
 
+namespace {
+
+std::atomic<std::uint64_t> nextPoolSerial {1};
+
+std::uint32_t nextGeneration(std::uint32_t generation)
+{
+    // Skip 0 on wraparound, so that a valid id is never 0
+    return generation + 1 == 0 ? 1 : generation + 1;
+}
+
+} // namespace
+
 Id IdPool::create()
 {
     if (!_free.empty()) {
-        auto id = _free.front();
-        _free.pop();
-        return id;
+        auto index = _free.back();
+        _free.pop_back();
+        return Id{index, _generations.at(index)};
     }
 
-    auto id = _nextId;
-    _nextId = Id{_nextId + 1};
-    return id;
+    auto index = static_cast<std::uint32_t>(_generations.size());
+    _generations.push_back(1);
+    return Id{index, 1};
 }
 
 void IdPool::kill(Id id)
 {
-    _free.push(id);
+    if (!alive(id)) {
+        return;
+    }
+
+    auto& generation = _generations.at(id.index());
+    generation = nextGeneration(generation);
+    _free.push_back(id.index());
+}
+
+bool IdPool::alive(Id id) const
+{
+    return id.index() < _generations.size() &&
+        _generations[id.index()] == id.generation();
+}
+
+size_t IdPool::capacity() const
+{
+    return _generations.size();
+}
+
+struct ConcurrentIdPool::ThreadCache {
+    std::uint64_t poolSerial = 0;
+    std::weak_ptr<const bool> pool;
+    std::uint32_t count = 0;
+    std::array<std::uint32_t, threadCacheSize> indices {};
+};
+
+struct ConcurrentIdPool::ThreadCaches {
+    std::vector<std::unique_ptr<ThreadCache>> caches;
+    ThreadCache* last = nullptr;
+};
+
+ConcurrentIdPool::ConcurrentIdPool(std::uint32_t capacity)
+    : _serial(nextPoolSerial.fetch_add(1, std::memory_order_relaxed))
+    , _capacity(capacity)
+    , _generations(std::make_unique<std::atomic<std::uint32_t>[]>(capacity))
+    , _next(std::make_unique<std::atomic<std::uint32_t>[]>(capacity))
+{
+    for (std::uint32_t i = 0; i < capacity; i++) {
+        _generations[i].store(1, std::memory_order_relaxed);
+    }
+}
+
+Id ConcurrentIdPool::create()
+{
+    auto& cache = threadCache();
+    if (cache.count == 0) {
+        refill(cache);
+    }
+
+    auto index = cache.indices[--cache.count];
+    return Id{index, _generations[index].load(std::memory_order_acquire)};
+}
+
+void ConcurrentIdPool::kill(Id id)
+{
+    if (id.index() >= _capacity) {
+        return;
+    }
+
+    // Only the first kill of a live id wins, stale and repeated kills are
+    // ignored
+    auto generation = id.generation();
+    if (!_generations[id.index()].compare_exchange_strong(
+            generation,
+            nextGeneration(generation),
+            std::memory_order_acq_rel)) {
+        return;
+    }
+
+    auto& cache = threadCache();
+    if (cache.count == threadCacheSize) {
+        static constexpr auto half = threadCacheSize / 2;
+        pushFree(cache.indices.data() + half, half);
+        cache.count = half;
+    }
+    cache.indices[cache.count++] = id.index();
+}
+
+bool ConcurrentIdPool::alive(Id id) const
+{
+    return id.index() < _capacity &&
+        _generations[id.index()].load(std::memory_order_acquire) ==
+            id.generation();
+}
+
+std::uint32_t ConcurrentIdPool::capacity() const
+{
+    return _capacity;
+}
+
+void ConcurrentIdPool::flushThreadCache()
+{
+    auto& caches = threadCaches();
+    auto it = std::ranges::find_if(caches.caches, [this] (const auto& cache) {
+        return cache->poolSerial == _serial;
+    });
+    if (it == caches.caches.end()) {
+        return;
+    }
+
+    pushFree((*it)->indices.data(), (*it)->count);
+    if (caches.last == it->get()) {
+        caches.last = nullptr;
+    }
+    caches.caches.erase(it);
+}
+
+ConcurrentIdPool::ThreadCaches& ConcurrentIdPool::threadCaches()
+{
+    thread_local auto caches = ThreadCaches{};
+    return caches;
+}
+
+ConcurrentIdPool::ThreadCache& ConcurrentIdPool::threadCache()
+{
+    // Keyed by pool serial rather than address, so that a pool allocated at
+    // the address of a destroyed one never picks up its stale cache
+    auto& caches = threadCaches();
+    if (caches.last && caches.last->poolSerial == _serial) {
+        return *caches.last;
+    }
+
+    // Indices cached for destroyed pools went away with them
+    std::erase_if(caches.caches, [] (const auto& cache) {
+        return cache->pool.expired();
+    });
+
+    auto it = std::ranges::find_if(caches.caches, [this] (const auto& cache) {
+        return cache->poolSerial == _serial;
+    });
+    if (it == caches.caches.end()) {
+        caches.caches.push_back(std::make_unique<ThreadCache>(ThreadCache{
+            .poolSerial = _serial,
+            .pool = _lifetime,
+        }));
+        it = caches.caches.end() - 1;
+    }
+    caches.last = it->get();
+    return *caches.last;
+}
+
+void ConcurrentIdPool::refill(ThreadCache& cache)
+{
+    static constexpr auto batch = threadCacheSize / 2;
+
+    cache.count = popFree(cache.indices.data(), batch);
+    if (cache.count > 0) {
+        return;
+    }
+
+    auto first = _fresh.load(std::memory_order_relaxed);
+    auto count = std::uint32_t{0};
+    do {
+        if (first >= _capacity) {
+            throw Error{"id pool capacity of " + std::to_string(_capacity) +
+                " is exhausted"};
+        }
+        count = std::min(batch, _capacity - first);
+    } while (!_fresh.compare_exchange_weak(
+        first, first + count, std::memory_order_relaxed));
+
+    // Reversed, so that the lowest index is handed out first
+    for (auto i = count; i-- > 0; ) {
+        cache.indices[cache.count++] = first + i;
+    }
+}
+
+void ConcurrentIdPool::pushFree(
+    const std::uint32_t* indices, std::uint32_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    for (std::uint32_t i = 0; i + 1 < count; i++) {
+        _next[indices[i]].store(indices[i + 1] + 1, std::memory_order_relaxed);
+    }
+
+    auto last = indices[count - 1];
+    auto head = _head.load(std::memory_order_relaxed);
+    std::uint64_t newHead = 0;
+    do {
+        _next[last].store(
+            static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+        newHead = ((head >> 32) + 1) << 32 | (indices[0] + 1);
+    } while (!_head.compare_exchange_weak(
+        head, newHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+std::uint32_t ConcurrentIdPool::popFree(
+    std::uint32_t* indices, std::uint32_t maxCount)
+{
+    // The tag changes on every successful exchange, so if the exchange below
+    // succeeds, nobody touched the list while the chain was being read
+    auto head = _head.load(std::memory_order_acquire);
+    for (;;) {
+        auto link = static_cast<std::uint32_t>(head);
+        auto count = std::uint32_t{0};
+        while (link != 0 && count < maxCount) {
+            indices[count++] = link - 1;
+            link = _next[link - 1].load(std::memory_order_relaxed);
+        }
+        if (count == 0) {
+            return 0;
+        }
+
+        auto newHead = ((head >> 32) + 1) << 32 | link;
+        if (_head.compare_exchange_weak(
+                head,
+                newHead,
+                std::memory_order_acquire,
+                std::memory_order_acquire)) {
+            return count;
+        }
+    }
 }
 
 } // namespace gx
@@ -1,11 +1,24 @@
 #pragma once
 
+#include <gx/blitter.hpp>
 #include <gx/box.hpp>
+#include <gx/capture.hpp>
+#include <gx/collision.hpp>
+#include <gx/damage.hpp>
 #include <gx/error.hpp>
+#include <gx/frame_arena.hpp>
+#include <gx/frame_clock.hpp>
 #include <gx/geometry.hpp>
+#include <gx/hit_grid.hpp>
 #include <gx/id.hpp>
+#include <gx/latency.hpp>
+#include <gx/mpsc_ring.hpp>
 #include <gx/renderer.hpp>
+#include <gx/replay.hpp>
+#include <gx/scaled_cache.hpp>
 #include <gx/scene.hpp>
 #include <gx/sprite.hpp>
+#include <gx/trace.hpp>
+#include <gx/triple_buffer.hpp>
 #include <gx/ui.hpp>
 #include <gx/ui_coordinate.hpp>
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <gx/renderer.hpp>
+
+#include <SDL.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace gx {
+
+// Premultiplied ARGB8888 pixels in system memory, with rows packed
+// back to back. Indexed images instead keep a byte per pixel, which may be
+// shared with other images, and a palette of premultiplied colors.
+class Image {
+public:
+    Image() = default;
+    // Transparent image
+    explicit Image(const PixelVector& size);
+    // Converts and premultiplies a surface of any format
+    explicit Image(SDL_Surface* surface);
+    Image(
+        const PixelVector& size,
+        std::shared_ptr<const std::vector<std::uint8_t>> indices,
+        const Palette& palette);
+
+    const PixelVector& size() const;
+    // True when no pixel has alpha below 255
+    bool opaque() const;
+    bool indexed() const;
+
+    // Not for indexed images
+    std::uint32_t* row(int y);
+    const std::uint32_t* row(int y) const;
+
+    // Only for indexed images
+    const std::uint8_t* indexRow(int y) const;
+    const std::uint32_t* palette() const;
+
+private:
+    PixelVector _size;
+    std::vector<std::uint32_t> _pixels;
+    std::shared_ptr<const std::vector<std::uint8_t>> _indices;
+    std::vector<std::uint32_t> _palette;
+    bool _opaque = false;
+};
+
+enum class SimdLevel {
+    Scalar,
+    Sse2,
+    Avx2,
+};
+
+// Best level supported by both the build and the CPU
+SimdLevel detectSimdLevel();
+
+// Row kernels. All pixels are premultiplied ARGB8888 and no pointer needs
+// to be aligned.
+struct BlitKernels {
+    void (*fill)(std::uint32_t* dst, std::uint32_t color, int count);
+    void (*copy)(std::uint32_t* dst, const std::uint32_t* src, int count);
+    // dst = src + dst * (255 - src alpha) / 255, saturated per channel
+    void (*blend)(std::uint32_t* dst, const std::uint32_t* src, int count);
+    // Nearest-neighbour upscaling: dst[i] = src[(i + phase) / scale]
+    void (*expand)(
+        std::uint32_t* dst,
+        const std::uint32_t* src,
+        int count,
+        int scale,
+        int phase);
+    // Palette lookup: dst[i] = palette[src[i]], with 256 palette entries
+    void (*lookup)(
+        std::uint32_t* dst,
+        const std::uint8_t* src,
+        const std::uint32_t* palette,
+        int count);
+    // Straight to premultiplied alpha, dst and src may be the same row
+    void (*premultiply)(
+        std::uint32_t* dst, const std::uint32_t* src, int count);
+};
+
+// Kernels for a level the CPU supports, the scalar ones otherwise
+const BlitKernels& blitKernels(SimdLevel level);
+
+// Premultiplies the alpha of an ARGB8888 surface in place
+void premultiply(SDL_Surface* surface);
+
+// Rasterizes Renderer's draw calls into a framebuffer in system memory,
+// following SDL's semantics: sprites blend, rectangles overwrite and the
+// clip rectangle applies to whichever image is the current target.
+//
+// Drawing is recorded and only rasterized by flush, which happens when the
+// target changes. With more than one thread, the target is cut into tiles
+// that each get the commands overlapping them, in submission order, and
+// the tiles are shared out among worker threads and the caller. Images
+// stay referenced until their commands are rasterized.
+class Blitter {
+public:
+    // Threads include the calling one, 0 means one per core
+    explicit Blitter(int threads = 1, SimdLevel level = detectSimdLevel());
+    ~Blitter();
+
+    Blitter(const Blitter&) = delete;
+    Blitter(Blitter&&) = delete;
+    Blitter& operator=(const Blitter&) = delete;
+    Blitter& operator=(Blitter&&) = delete;
+
+    // Keeps the contents when the size does not change
+    void resize(const PixelVector& size);
+    // As of the last flush
+    const Image& framebuffer() const;
+
+    // Draws into the image, or back into the framebuffer for nullptr
+    void setTarget(std::shared_ptr<Image> target);
+    void setClip(const std::optional<PixelRectangle>& clip);
+
+    // Ignores the clip rectangle, like SDL_RenderClear
+    void clear(std::uint32_t color);
+    void fill(const PixelRectangle& area, std::uint32_t color);
+    // Opaque draws copy, even if the image has translucent pixels elsewhere
+    void draw(
+        std::shared_ptr<const Image> image,
+        const PixelRectangle& frame,
+        const ScreenPoint& position,
+        float zoom,
+        bool opaque = false);
+
+    // Rasterizes everything recorded for the current target
+    void flush();
+
+private:
+    struct Command {
+        // Destination inside the target and the clip rectangle
+        PixelRectangle area;
+        // Whole destination of a draw, before clipping
+        PixelRectangle destination;
+        PixelRectangle frame;
+        // Fills have no image
+        std::shared_ptr<const Image> image;
+        std::uint32_t color = 0;
+        bool opaque = false;
+    };
+
+    // Rows a thread rasterizes from
+    struct Scratch {
+        // Source pixels looked up in an indexed image's palette
+        std::vector<std::uint32_t> colors;
+        // Source row scaled to the destination width
+        std::vector<std::uint32_t> expanded;
+    };
+
+    Image& target();
+    // Part of the area inside both the target and the clip rectangle
+    std::optional<PixelRectangle> visible(const PixelRectangle& area);
+    void execute(
+        const Command& command,
+        const PixelRectangle& bounds,
+        Scratch& scratch);
+    void rasterizeTiles(Scratch& scratch);
+    void work();
+
+    const BlitKernels& _kernels;
+    Image _framebuffer;
+    std::shared_ptr<Image> _target;
+    std::optional<PixelRectangle> _clip;
+    std::vector<Command> _commands;
+    Scratch _scratch;
+
+    // Command indices per tile, row by row
+    std::vector<std::vector<std::uint32_t>> _bins;
+    int _tileColumns = 0;
+    std::atomic<size_t> _nextTile = 0;
+
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _finish;
+    std::uint64_t _generation = 0;
+    size_t _busyWorkers = 0;
+    bool _stopping = false;
+};
+
+} // namespace gx
@@ -1,11 +1,20 @@
 #pragma once
 
+#include <gx/damage.hpp>
+#include <gx/frame_arena.hpp>
+#include <gx/frame_clock.hpp>
+#include <gx/hit_grid.hpp>
+#include <gx/latency.hpp>
 #include <gx/renderer.hpp>
+#include <gx/replay.hpp>
 #include <gx/scene.hpp>
 #include <gx/ui.hpp>
 
+#include <array>
+#include <atomic>
 #include <cstddef>
 #include <filesystem>
+#include <functional>
 #include <map>
 #include <memory>
 #include <span>
@@ -14,9 +23,53 @@
 
 namespace gx {
 
+struct Loop {
+    // Fixed simulation steps per second
+    int rate = 60;
+    // Steps simulated at most per frame. Time beyond that is dropped.
+    int maxCatchUpSteps = 5;
+    // Wait for the next step after presenting a frame. Turn off to let vsync
+    // pace the frames and use the interpolation alpha.
+    bool pace = true;
+    // How long before a step is due to stop sleeping and start spinning
+    float spinSeconds = 0.002f;
+    // Run onStep, onFrame and the update of simulated widgets (scenes) on a
+    // separate thread, so that a frame costs the slower of simulation and
+    // rendering rather than their sum. onEvent and widget input callbacks
+    // still run on the calling thread and must hand data over to the
+    // simulation in a thread-safe way.
+    bool pipelined = false;
+    // Poll input as late as possible before the predicted vsync, then update
+    // widgets (moving the scene camera) and present. Frames are paced by
+    // vsync, so pace is ignored.
+    bool latchInput = false;
+    // Slack between the predicted end of a latched frame and vsync
+    float latchMarginSeconds = 0.001f;
+    // When a frame had nothing to present, block until input arrives or
+    // a widget is due to change by itself, such as at its next animation
+    // frame, instead of waiting for the next step. Simulation steps stop
+    // meanwhile, so this is for screens that only input and animations
+    // change, like menus, editors or a paused game. Other threads can wake
+    // the loop by pushing a user event. Serial loops only.
+    bool waitWhenIdle = false;
+    // Records the input and steps of every frame
+    ReplayRecorder* recorder = nullptr;
+    // Takes input and steps from a recording instead of SDL and the clock.
+    // Frames are not paced, and the run ends with the recording. Replays
+    // and recordings need a serial loop.
+    ReplayPlayer* player = nullptr;
+
+    std::function<bool(const SDL_Event&)> onEvent =
+        [] (const SDL_Event&) { return false; };
+    std::function<void(float delta)> onStep = [] (float) {};
+    // Called once per frame before presenting, with the interpolation alpha
+    // between the last simulated step and the next one
+    std::function<void(float alpha)> onFrame = [] (float) {};
+};
+
 class Box {
 public:
-    Box();
+    explicit Box(const WindowConfig& config = {});
     ~Box();
 
     Box(const Box&) = delete;
@@ -30,33 +83,94 @@ public:
     static Cursor loadCursor(const std::filesystem::path& path, int x, int y);
     static void setCursor(Cursor& cursor);
 
+    // Drains the SDL event queue, merging runs of mouse motion events into
+    // one. Every event that gx does not consume is passed to the handler.
+    void pumpEvents(const std::function<bool(const SDL_Event&)>& handler);
+
+    // A few frequent event types that gx does not consume, such as touch
+    // and gesture events, are dropped before they reach the queue, unless
+    // accepted here. Safe to call while other threads push events.
+    void acceptEvent(Uint32 type);
+
     bool processEvent(const SDL_Event& e);
     void update(float delta);
-    void present();
+    // Draws and presents a frame, unless nothing changed since the last one
+    // or the window is minimized or hidden. Returns whether it did.
+    bool present();
+    // Redraws everything on the next present, for changes that gx cannot
+    // see, such as drawing into a bitmap that sprites show
+    void invalidate();
+
+    // Runs events, fixed simulation steps, update and present until the box
+    // dies or stop is called
+    void run(const Loop& loop);
+    void stop();
+    const PacingStats& pacingStats() const;
+    // Time from input events to the end of the first present after them
+    LatencyStats latencyStats() const;
 
     bool alive() const;
     bool dead() const;
 
     Renderer& renderer();
 
+    // Topmost widget whose hit area contains the window position
+    Widget* widgetAtPosition(int x, int y);
+    // Scratch memory of the thread calling update and present, reset at the
+    // start of every update and the end of every present
+    FrameArena& frameArena();
+
     template <class T, class... Args>
     requires std::derived_from<T, Widget> && std::constructible_from<T, Args...>
     T* createWidget(Args&&... args)
     {
         _widgets.push_back(std::make_unique<T>(std::forward<Args>(args)...));
+        _widgets.back()->_boxDirty = &_dirty;
+        _dirty.layout = true;
+        _dirty.render = true;
         return reinterpret_cast<T*>(_widgets.back().get());
     }
 
 private:
-    Widget* widgetAtPosition(int x, int y) const;
+    void runSerial(const Loop& loop);
+    void input(const Loop& loop);
+    void runPipelined(const Loop& loop);
+    // After a frame that was not presented
+    void waitIdle(const Loop& loop, const FrameClock& clock);
+
+    // Returns false when nothing changed
+    bool presentDamage();
+    // Non-retained widgets, then the UI layer over them
+    void renderWidgets();
+    void layout();
+    // Adds the areas that changed to the screen's damage
+    void renderUiLayer(Damage& screenDamage);
     bool processUiEvent(const SDL_Event& e);
 
-    bool _alive = true;
+    static int filterEvent(void* userdata, SDL_Event* e);
+
+    std::atomic<bool> _alive = true;
+    ReplayRecorder* _recorder = nullptr;
+    FrameArena _frameArena;
     Renderer _renderer;
+    PacingStats _pacingStats;
+    LatencyMeter _latency;
+    // Read by the event filter on whichever thread pushes an event
+    std::array<std::atomic<bool>, SDL_LASTEVENT + 1> _droppedEvents {};
+    // The filter installed before Box, which is chained and restored
+    SDL_EventFilter _previousFilter = nullptr;
+    void* _previousFilterData = nullptr;
 
     std::vector<std::unique_ptr<Widget>> _widgets;
     Widget* _focusedWidget = nullptr;
     Widget* _pressedWidget = nullptr;
+
+    UiDirtyFlags _dirty;
+    HitGrid _hitGrid;
+    Bitmap _uiLayer;
+    PixelVector _uiLayerSize;
+    // Damage cannot tell what changed, so redraw everything
+    bool _fullRedraw = true;
 };
 
 } // namespace gx
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <gx/renderer.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gx {
+
+enum class CaptureFormat {
+    // frame-000000.png, frame-000001.png, ... in a directory. Numbers of
+    // dropped frames are skipped.
+    PngSequence,
+    // One uncompressed YUV 4:4:4 stream, which ffmpeg and most players
+    // read. All frames must have the size of the first one.
+    Y4m,
+};
+
+struct CaptureConfig {
+    // Directory for PNG sequences, file for Y4M streams
+    std::filesystem::path path;
+    CaptureFormat format = CaptureFormat::PngSequence;
+    // Frames that can wait for the encoder before new ones are dropped
+    size_t queueDepth = 4;
+    // Frame rate written into Y4M streams
+    int rate = 60;
+};
+
+struct CaptureStats {
+    // Frames handed to the encoder, and the ones dropped because it was
+    // behind or the size changed
+    size_t captured = 0;
+    size_t dropped = 0;
+    size_t written = 0;
+    // Time the rendering thread spent reading back and queueing frames
+    double meanCaptureSeconds = 0.0;
+    double maxCaptureSeconds = 0.0;
+    // Time the encoder thread spent on each written frame
+    double meanEncodeSeconds = 0.0;
+};
+
+// Records frames without encoding them on the rendering thread. Frames are
+// read back into a fixed pool of buffers and written by a thread of their
+// own; while every buffer waits for that thread, new frames are dropped
+// rather than waited for.
+class FrameCapture {
+public:
+    explicit FrameCapture(const CaptureConfig& config);
+    // Writes the frames still queued
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture(FrameCapture&&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+    FrameCapture& operator=(FrameCapture&&) = delete;
+
+    // Has the reader fill a free buffer with ARGB8888 rows, pitch in bytes,
+    // and queues it. Returns false if the frame was dropped instead.
+    bool capture(
+        const PixelVector& size,
+        const std::function<void(std::uint32_t* pixels, int pitch)>& read);
+
+    // Writes the frames still queued and rethrows the encoder's error, if
+    // any. Later frames are dropped.
+    void stop();
+    bool running() const;
+
+    CaptureStats stats() const;
+
+private:
+    struct Frame {
+        std::uint64_t index = 0;
+        PixelVector size;
+        std::vector<std::uint32_t> pixels;
+    };
+
+    void work();
+    void encode(const Frame& frame);
+    void writePng(const Frame& frame);
+    void writeY4m(const Frame& frame);
+
+    CaptureConfig _config;
+    std::uint64_t _nextIndex = 0;
+    // Size every Y4M frame must have, that of the first one
+    PixelVector _streamSize;
+
+    // Only touched by the encoder thread
+    std::ofstream _stream;
+    bool _streamStarted = false;
+    std::vector<std::uint8_t> _planes;
+
+    std::vector<Frame> _frames;
+    mutable std::mutex _mutex;
+    std::condition_variable _queuedChanged;
+    std::vector<size_t> _free;
+    std::deque<size_t> _queued;
+    std::exception_ptr _error;
+    bool _stopping = false;
+    CaptureStats _stats;
+    double _captureSeconds = 0.0;
+    double _encodeSeconds = 0.0;
+    std::thread _encoder;
+};
+
+} // namespace gx
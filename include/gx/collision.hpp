@@ -0,0 +1,235 @@
+#pragma once
+
+#include <gx/geometry.hpp>
+#include <gx/id.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace gx {
+
+template <class T, class Tag>
+struct Circle {
+    Point<T, Tag> center;
+    T radius {};
+};
+
+// Earliest fraction of motion in [0, 1] at which the moving circle touches the
+// target: 0 if they overlap from the start, nullopt if they never touch
+template <class T, class Tag>
+std::optional<T> sweep(
+    const Circle<T, Tag>& moving,
+    const Vector<T, Tag>& motion,
+    const Circle<T, Tag>& target)
+{
+    auto offset = moving.center - target.center;
+    auto radius = moving.radius + target.radius;
+
+    auto c = dot(offset, offset) - radius * radius;
+    if (c <= 0) {
+        return T{0};
+    }
+
+    auto b = dot(offset, motion);
+    if (b >= 0) {
+        return std::nullopt;
+    }
+
+    auto a = dot(motion, motion);
+    auto discriminant = b * b - a * c;
+    if (discriminant < 0) {
+        return std::nullopt;
+    }
+
+    auto time = (-b - std::sqrt(discriminant)) / a;
+    if (time > 1) {
+        return std::nullopt;
+    }
+    return time;
+}
+
+template <class T, class Tag>
+std::optional<T> sweep(
+    const Circle<T, Tag>& moving,
+    const Vector<T, Tag>& motion,
+    const Rectangle<T, Tag>& target)
+{
+    const auto& start = moving.center;
+    const auto r = moving.radius;
+
+    auto closest = Point<T, Tag>{
+        .x = std::clamp(start.x, target.x, target.x + target.w),
+        .y = std::clamp(start.y, target.y, target.y + target.h),
+    };
+    if (auto toClosest = start - closest;
+            dot(toClosest, toClosest) <= r * r) {
+        return T{0};
+    }
+
+    // Slab test against the rectangle grown by the radius on every side
+    T enter = 0;
+    T leave = 1;
+    auto slab = [&enter, &leave] (T from, T delta, T low, T high) {
+        if (delta == 0) {
+            return from >= low && from <= high;
+        }
+        auto t1 = (low - from) / delta;
+        auto t2 = (high - from) / delta;
+        if (t1 > t2) {
+            std::swap(t1, t2);
+        }
+        enter = std::max(enter, t1);
+        leave = std::min(leave, t2);
+        return enter <= leave;
+    };
+    if (!slab(start.x, motion.x, target.x - r, target.x + target.w + r) ||
+            !slab(start.y, motion.y, target.y - r, target.y + target.h + r)) {
+        return std::nullopt;
+    }
+
+    // Entering through a corner of the grown rectangle only counts if the
+    // rounded corner is hit as well
+    auto entry = start + motion * enter;
+    bool outsideX = entry.x < target.x || entry.x > target.x + target.w;
+    bool outsideY = entry.y < target.y || entry.y > target.y + target.h;
+    if (outsideX && outsideY) {
+        auto corner = Point<T, Tag>{
+            .x = entry.x < target.x ? target.x : target.x + target.w,
+            .y = entry.y < target.y ? target.y : target.y + target.h,
+        };
+        return sweep(moving, motion, Circle<T, Tag>{.center = corner});
+    }
+
+    return enter;
+}
+
+// Uniform grid of static shapes, queried for the earliest time of impact
+template <class T, class Tag>
+class Broadphase {
+public:
+    using Shape = std::variant<Circle<T, Tag>, Rectangle<T, Tag>>;
+
+    struct Hit {
+        Id id;
+        T time {};
+    };
+
+    Broadphase() = default;
+
+    explicit Broadphase(T cellSize)
+        : _cellSize(cellSize)
+    { }
+
+    void insert(Id id, const Shape& shape)
+    {
+        erase(id);
+        _shapes.emplace(id, shape);
+        forEachCell(bounds(shape), [this, id] (std::uint64_t key) {
+            _cells[key].push_back(id);
+        });
+    }
+
+    void erase(Id id)
+    {
+        auto it = _shapes.find(id);
+        if (it == _shapes.end()) {
+            return;
+        }
+
+        forEachCell(bounds(it->second), [this, id] (std::uint64_t key) {
+            auto cell = _cells.find(key);
+            std::erase(cell->second, id);
+            if (cell->second.empty()) {
+                _cells.erase(cell);
+            }
+        });
+        _shapes.erase(it);
+    }
+
+    std::optional<Hit> sweep(
+        const Circle<T, Tag>& moving, const Vector<T, Tag>& motion) const
+    {
+        auto startBounds = bounds(Shape{moving});
+        auto endBounds = startBounds;
+        endBounds.x += motion.x;
+        endBounds.y += motion.y;
+
+        auto x = std::min(startBounds.x, endBounds.x);
+        auto y = std::min(startBounds.y, endBounds.y);
+        auto sweptBounds = Rectangle<T, Tag>{
+            .x = x,
+            .y = y,
+            .w = std::max(startBounds.x, endBounds.x) + startBounds.w - x,
+            .h = std::max(startBounds.y, endBounds.y) + startBounds.h - y,
+        };
+
+        auto earliest = std::optional<Hit>{};
+        forEachCell(sweptBounds, [&] (std::uint64_t key) {
+            auto cell = _cells.find(key);
+            if (cell == _cells.end()) {
+                return;
+            }
+            for (auto id : cell->second) {
+                auto time = std::visit([&] (const auto& target) {
+                    return gx::sweep(moving, motion, target);
+                }, _shapes.at(id));
+                if (time && (!earliest || *time < earliest->time)) {
+                    earliest = Hit{.id = id, .time = *time};
+                }
+            }
+        });
+        return earliest;
+    }
+
+    std::optional<Hit> segment(
+        const Point<T, Tag>& start, const Point<T, Tag>& end) const
+    {
+        return sweep(Circle<T, Tag>{.center = start}, end - start);
+    }
+
+private:
+    static Rectangle<T, Tag> bounds(const Shape& shape)
+    {
+        if (const auto* circle = std::get_if<Circle<T, Tag>>(&shape)) {
+            return Rectangle<T, Tag>::atPosition(
+                circle->center, {2 * circle->radius, 2 * circle->radius});
+        }
+        return std::get<Rectangle<T, Tag>>(shape);
+    }
+
+    static std::uint64_t cellKey(std::int32_t i, std::int32_t j)
+    {
+        return static_cast<std::uint64_t>(static_cast<std::uint32_t>(i)) << 32 |
+            static_cast<std::uint32_t>(j);
+    }
+
+    template <class F>
+    void forEachCell(const Rectangle<T, Tag>& area, F&& f) const
+    {
+        auto cellIndex = [this] (T coordinate) {
+            return
+                static_cast<std::int32_t>(std::floor(coordinate / _cellSize));
+        };
+
+        auto xEnd = cellIndex(area.x + area.w);
+        auto yEnd = cellIndex(area.y + area.h);
+        for (auto i = cellIndex(area.x); i <= xEnd; i++) {
+            for (auto j = cellIndex(area.y); j <= yEnd; j++) {
+                f(cellKey(i, j));
+            }
+        }
+    }
+
+    T _cellSize = 1;
+    std::map<Id, Shape> _shapes;
+    std::unordered_map<std::uint64_t, std::vector<Id>> _cells;
+};
+
+} // namespace gx
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <gx/renderer.hpp>
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace gx {
+
+// Screen areas that may look different from the last presented frame, in
+// whole pixels. Overlapping areas are merged into their bounding box. When
+// the areas cover more than the given share of the screen, or there are
+// too many of them to be worth drawing one by one, the whole screen is
+// damaged instead.
+class Damage {
+public:
+    explicit Damage(
+        const PixelVector& screenSize,
+        float fullShare = 0.5f,
+        std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    void add(const ScreenRectangle& area);
+    void addAll();
+
+    bool empty() const;
+    bool full() const;
+    // Disjoint areas inside the screen, just the screen when full
+    const std::pmr::vector<PixelRectangle>& areas() const;
+
+private:
+    PixelVector _screenSize;
+    std::int64_t _fullArea = 0;
+    std::int64_t _area = 0;
+    std::pmr::vector<PixelRectangle> _areas;
+    bool _full = false;
+};
+
+} // namespace gx
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace gx {
+
+struct ArenaStats {
+    // Bytes handed out since the last reset, including alignment padding
+    size_t used = 0;
+    size_t capacity = 0;
+    // Most bytes used between two resets
+    size_t highWater = 0;
+    // Extra heap blocks allocated because a frame did not fit
+    size_t overflows = 0;
+};
+
+// Bump allocator for data that lives until the end of a frame. Deallocation
+// is a no-op and reset makes all memory available again, so nothing
+// allocated from the arena may outlive the frame. When a frame does not fit,
+// the arena takes more blocks from the heap and grows to the high-water mark
+// on the next reset, so a steady workload stops touching the heap.
+//
+// Not thread-safe. In debug builds released memory is filled with 0xDD, so
+// use after reset shows up quickly.
+class FrameArena : public std::pmr::memory_resource {
+public:
+    explicit FrameArena(size_t capacity = 64 * 1024);
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena(FrameArena&&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+    FrameArena& operator=(FrameArena&&) = delete;
+
+    void reset();
+
+    const ArenaStats& stats() const;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(
+        const std::pmr::memory_resource& other) const noexcept override;
+
+    std::unique_ptr<std::byte[]> _block;
+    size_t _offset = 0;
+    std::vector<std::unique_ptr<std::byte[]>> _overflowBlocks;
+    ArenaStats _stats;
+};
+
+} // namespace gx
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <cstddef>
+
+namespace gx {
+
+struct PacingStats {
+    size_t frames = 0;
+    // Simulation steps dropped because a frame needed more than the maximum
+    // number of catch-up steps
+    size_t droppedSteps = 0;
+    double meanFrameSeconds = 0.0;
+    // Standard deviation of the frame time
+    double jitterSeconds = 0.0;
+    // Largest difference between a frame time and the step duration
+    double maxDeviationSeconds = 0.0;
+};
+
+// Sleeps until spinSeconds before the performance counter reaches deadline,
+// then spins
+void waitUntil(Uint64 deadline, float spinSeconds);
+
+// Fixed-step simulation clock on top of SDL's performance counter
+class FrameClock {
+public:
+    FrameClock(int rate, int maxSteps);
+
+    // Number of steps to simulate since the last call, at most maxSteps
+    int advance();
+
+    float delta() const;
+    // How far the clock is between the last simulated step and the next one
+    float alpha() const;
+
+    // Sleeps until spinSeconds before the next step is due, then spins
+    void waitForNextStep(float spinSeconds) const;
+
+    // Records the time between consecutive calls as frame times
+    void markFrame();
+    const PacingStats& stats() const;
+
+private:
+    Uint64 _frequency = 0;
+    Uint64 _stepTicks = 0;
+    int _maxSteps = 0;
+
+    Uint64 _lastAdvance = 0;
+    Uint64 _accumulated = 0;
+
+    Uint64 _lastFrame = 0;
+    double _frameSecondsM2 = 0.0;
+    PacingStats _stats;
+};
+
+} // namespace gx
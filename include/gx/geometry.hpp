@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <optional>
 #include <ostream>
 
 namespace gx {
@@ -72,6 +74,8 @@ struct Vector {
         return copy;
     }
 
+    constexpr bool operator==(const Vector&) const = default;
+
     T x {};
     T y {};
 };
@@ -125,6 +129,12 @@ constexpr Vector<T, Tag> operator-(const Vector<T, Tag>& vector)
     return {-vector.x, -vector.y};
 }
 
+template <class T, class Tag>
+constexpr T dot(const Vector<T, Tag>& lhs, const Vector<T, Tag>& rhs)
+{
+    return lhs.x * rhs.x + lhs.y * rhs.y;
+}
+
 template <class U, class V, class Tag>
 constexpr Vector<U, Tag> cast(const Vector<V, Tag>& source)
 {
@@ -147,6 +157,8 @@ struct Point {
         return *this;
     }
 
+    constexpr bool operator==(const Point&) const = default;
+
     T x {};
     T y {};
 };
@@ -222,12 +234,38 @@ struct Rectangle {
         return {x + w / 2, y + h / 2};
     }
 
+    constexpr bool operator==(const Rectangle&) const = default;
+
     T x {};
     T y {};
     T w {};
     T h {};
 };
 
+template <class T, class Tag>
+constexpr bool intersects(
+    const Rectangle<T, Tag>& lhs, const Rectangle<T, Tag>& rhs)
+{
+    return
+        lhs.x <= rhs.x + rhs.w && rhs.x <= lhs.x + lhs.w &&
+        lhs.y <= rhs.y + rhs.h && rhs.y <= lhs.y + lhs.h;
+}
+
+// Area covered by both, nothing if they only touch or are apart
+template <class T, class Tag>
+constexpr std::optional<Rectangle<T, Tag>> intersection(
+    const Rectangle<T, Tag>& lhs, const Rectangle<T, Tag>& rhs)
+{
+    auto left = std::max(lhs.x, rhs.x);
+    auto top = std::max(lhs.y, rhs.y);
+    auto right = std::min(lhs.x + lhs.w, rhs.x + rhs.w);
+    auto bottom = std::min(lhs.y + lhs.h, rhs.y + rhs.h);
+    if (left >= right || top >= bottom) {
+        return std::nullopt;
+    }
+    return Rectangle<T, Tag>{left, top, right - left, bottom - top};
+}
+
 template <class T, class Tag>
 std::ostream& operator<<(
     std::ostream& output, const Rectangle<T, Tag>& rectangle)
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <gx/renderer.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace gx {
+
+// Uniform grid over the window for mouse hit testing. Areas are inserted in
+// increasing z-order, and find returns the topmost one containing a point.
+class HitGrid {
+public:
+    void reset(const ScreenRectangle& bounds);
+    void insert(size_t index, const ScreenRectangle& area);
+
+    std::optional<size_t> find(const ScreenPoint& point) const;
+
+private:
+    static constexpr float cellSize = 64.f;
+
+    struct Entry {
+        size_t index = 0;
+        ScreenRectangle area;
+    };
+
+    int column(float x) const;
+    int row(float y) const;
+
+    ScreenRectangle _bounds;
+    int _columns = 0;
+    int _rows = 0;
+    std::vector<std::vector<Entry>> _cells;
+};
+
+} // namespace gx
@@ -1,18 +1,36 @@
 #pragma once
 
-#include <map>
-#include <queue>
+#include <gx/error.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 namespace gx {
 
+// Lower half of an id is a slot index, upper half is the generation of that
+// slot. Generations start at 1, so a valid id is never 0.
 class Id {
 public:
-    using Base = unsigned long;
+    using Base = std::uint64_t;
 
     explicit Id(Base id) : _id(id) {}
+    Id(std::uint32_t index, std::uint32_t generation)
+        : _id(Base{generation} << 32 | index)
+    { }
+
     operator Base() const { return _id; }
 
+    std::uint32_t index() const { return static_cast<std::uint32_t>(_id); }
+    std::uint32_t generation() const
+    {
+        return static_cast<std::uint32_t>(_id >> 32);
+    }
+
 private:
     Base _id = 0;
 };
@@ -22,21 +40,73 @@ public:
     Id create();
     void kill(Id id);
 
+    bool alive(Id id) const;
+
+    // Number of slot indices ever handed out
+    size_t capacity() const;
+
 private:
-    Id _nextId {1};
-    std::queue<Id> _free;
+    std::vector<std::uint32_t> _generations;
+    std::vector<std::uint32_t> _free;
+};
+
+// Thread-safe IdPool with a fixed capacity. Each thread keeps a small cache of
+// free slot indices and exchanges them in batches with a lock-free global free
+// list. Ids freed by a thread stay in its cache until reused, so a worker that
+// is about to exit should call flushThreadCache, which also releases the
+// cache. Caches of destroyed pools are released on the thread's next lookup.
+class ConcurrentIdPool {
+public:
+    static constexpr std::uint32_t threadCacheSize = 64;
+
+    explicit ConcurrentIdPool(std::uint32_t capacity);
+
+    ConcurrentIdPool(const ConcurrentIdPool&) = delete;
+    ConcurrentIdPool(ConcurrentIdPool&&) = delete;
+    ConcurrentIdPool& operator=(const ConcurrentIdPool&) = delete;
+    ConcurrentIdPool& operator=(ConcurrentIdPool&&) = delete;
+
+    Id create();
+    void kill(Id id);
+
+    bool alive(Id id) const;
+    std::uint32_t capacity() const;
+
+    void flushThreadCache();
+
+private:
+    struct ThreadCache;
+    struct ThreadCaches;
+
+    static ThreadCaches& threadCaches();
+    ThreadCache& threadCache();
+    void refill(ThreadCache& cache);
+    void pushFree(const std::uint32_t* indices, std::uint32_t count);
+    std::uint32_t popFree(std::uint32_t* indices, std::uint32_t maxCount);
+
+    const std::uint64_t _serial;
+    // Expires with the pool, which tells thread caches that they are stale
+    const std::shared_ptr<const bool> _lifetime =
+        std::make_shared<const bool>(true);
+    const std::uint32_t _capacity;
+    std::unique_ptr<std::atomic<std::uint32_t>[]> _generations;
+    // Free list links, stored as index + 1 so that 0 terminates the list
+    std::unique_ptr<std::atomic<std::uint32_t>[]> _next;
+    // Free list head: ABA tag in the upper half, index + 1 in the lower half
+    alignas(64) std::atomic<std::uint64_t> _head {0};
+    alignas(64) std::atomic<std::uint32_t> _fresh {0};
 };
 
 template <class Id, class Object>
 class ObjectCacheIterator {
 public:
-    explicit ObjectCacheIterator(typename std::map<Id, Object>::iterator base)
+    explicit ObjectCacheIterator(typename std::vector<Object>::iterator base)
         : _base(base)
     { }
 
     Object& operator*() const
     {
-        return _base->second;
+        return *_base;
     }
 
     ObjectCacheIterator& operator++()
@@ -55,20 +125,20 @@ public:
     auto operator<=>(const ObjectCacheIterator&) const = default;
 
 private:
-    typename std::map<Id, Object>::iterator _base;
+    typename std::vector<Object>::iterator _base;
 };
 
 template <class Id, class Object>
 class ObjectCacheConstIterator {
 public:
     explicit ObjectCacheConstIterator(
-        typename std::map<Id, Object>::const_iterator base)
+        typename std::vector<Object>::const_iterator base)
         : _base(base)
     { }
 
     const Object& operator*() const
     {
-        return _base->second;
+        return *_base;
     }
 
     ObjectCacheConstIterator& operator++()
@@ -87,41 +157,62 @@ public:
     auto operator<=>(const ObjectCacheConstIterator&) const = default;
 
 private:
-    typename std::map<Id, Object>::const_iterator _base;
+    typename std::vector<Object>::const_iterator _base;
 };
 
+// Slot map: objects are kept densely packed in insertion order (modulo
+// swap-with-last on removal), and a sparse per-slot index maps an id to its
+// object. A stale id (one whose slot was reused) never aliases a new object.
 template <class Id, class Object>
 class ObjectCache {
 public:
     Id push(Object&& object)
     {
-        auto id = Id{_ids.create()};
-        _objects.emplace(id, std::move(object));
-        return id;
+        return insert(std::move(object));
     }
 
     template <class... Args>
     Id emplace(Args&&... args)
     {
-        auto id = Id{_ids.create()};
-        _objects.emplace(id, Object{std::forward<Args>(args)...});
-        return id;
+        return insert(Object{std::forward<Args>(args)...});
     }
 
     void pop(Id id)
     {
-        _objects.erase(id);
-        _ids.kill(id);
+        auto raw = rawId(id);
+        if (!_ids.alive(raw)) {
+            return;
+        }
+
+        auto position = _positions.at(raw.index());
+        if (position + 1 != _objects.size()) {
+            _objects.at(position) = std::move(_objects.back());
+            _owners.at(position) = _owners.back();
+            _positions.at(_owners.at(position).index()) = position;
+        }
+        _objects.pop_back();
+        _owners.pop_back();
+        _ids.kill(raw);
+    }
+
+    bool contains(Id id) const
+    {
+        return _ids.alive(rawId(id));
+    }
+
+    size_t size() const
+    {
+        return _objects.size();
     }
 
     Object& operator[](Id id)
     {
-        return _objects.at(id);
+        return _objects[position(id)];
     }
 
     const Object& operator[](Id id) const
     {
-        return _objects.at(id);
+        return _objects[position(id)];
     }
 
     ObjectCacheIterator<Id, Object> begin()
@@ -145,7 +236,38 @@ public:
     }
 
 private:
-    std::map<Id, Object> _objects;
+    static gx::Id rawId(Id id)
+    {
+        return gx::Id{static_cast<gx::Id::Base>(id)};
+    }
+
+    Id insert(Object&& object)
+    {
+        auto raw = _ids.create();
+        if (_positions.size() < _ids.capacity()) {
+            _positions.resize(_ids.capacity());
+        }
+
+        _positions.at(raw.index()) =
+            static_cast<std::uint32_t>(_objects.size());
+        _objects.push_back(std::move(object));
+        _owners.push_back(raw);
+        return Id{raw};
+    }
+
+    size_t position(Id id) const
+    {
+        auto raw = rawId(id);
+        if (!_ids.alive(raw)) {
+            throw Error{"object id " + std::to_string(raw.index()) + "v" +
+                std::to_string(raw.generation()) + " is not alive"};
+        }
+        return _positions[raw.index()];
+    }
+
+    std::vector<Object> _objects;
+    std::vector<gx::Id> _owners;
+    std::vector<std::uint32_t> _positions;
     IdPool _ids;
 };
 
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gx {
+
+struct LatencyStats {
+    // Input events that reached a present
+    size_t samples = 0;
+    double meanSeconds = 0.0;
+    double p50Seconds = 0.0;
+    double p95Seconds = 0.0;
+    double p99Seconds = 0.0;
+    double maxSeconds = 0.0;
+};
+
+// Measures the time from an input event to the end of the first present
+// after the event was handled
+class LatencyMeter {
+public:
+    LatencyMeter();
+
+    // Remembers when an input event happened, ignores other events
+    void markInput(const SDL_Event& e);
+    // Attributes all input remembered since the last present to this one.
+    // Call right after presenting.
+    void markPresent();
+
+    LatencyStats stats() const;
+
+private:
+    // Percentiles come from a histogram with 0.1 ms buckets, the last one
+    // collecting everything from 200 ms on
+    static constexpr double bucketSeconds = 0.0001;
+    static constexpr size_t bucketCount = 2000;
+
+    Uint64 _frequency = 0;
+    std::vector<Uint64> _pendingInputs;
+    std::array<std::uint32_t, bucketCount> _histogram {};
+    size_t _samples = 0;
+    double _totalSeconds = 0.0;
+    double _maxSeconds = 0.0;
+};
+
+// Predicts the next vsync from the times presents return, so that input can
+// be latched as late as possible while the frame still makes it. Only as
+// good as the driver's blocking in present: with vsync off or deep
+// swapchains it degrades to latching right before presenting.
+class PresentPredictor {
+public:
+    explicit PresentPredictor(int refreshRate);
+
+    // Call right before polling input for a frame
+    void markLatch();
+    // Call right after presenting the frame
+    void markPresent();
+
+    // Performance counter value at which to latch input for the next frame
+    Uint64 latchDeadline(float marginSeconds) const;
+
+private:
+    Uint64 _frequency = 0;
+    Uint64 _period = 0;
+    Uint64 _lastLatch = 0;
+    Uint64 _lastPresent = 0;
+    // Recent worst time from latching to the end of present, decaying
+    // slowly so that a single hitch does not push the latch early forever
+    double _workTicks = 0.0;
+};
+
+} // namespace gx
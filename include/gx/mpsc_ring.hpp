@@ -0,0 +1,182 @@
+#pragma once
+
+#include <gx/error.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <type_traits>
+
+namespace gx {
+
+struct RingStats {
+    std::uint64_t published = 0;
+    // Values that did not fit, because the consumer fell behind
+    std::uint64_t rejected = 0;
+    std::uint64_t consumed = 0;
+    // Largest number of values seen waiting by the consumer
+    size_t highWater = 0;
+};
+
+// Bounded lock-free multi-producer single-consumer queue. Each slot carries a
+// sequence number telling whether it is free for the producers of the current
+// lap or holds a value for the consumer. Nothing is allocated after
+// construction.
+template <class T>
+requires std::is_trivially_copyable_v<T>
+class MpscRing {
+public:
+    explicit MpscRing(size_t capacity)
+        : _capacity(capacity)
+        , _slots(std::make_unique<Slot[]>(capacity))
+    {
+        if (!std::has_single_bit(capacity)) {
+            throw Error{"ring capacity " + std::to_string(capacity) +
+                " is not a power of two"};
+        }
+        for (size_t i = 0; i < capacity; i++) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing(MpscRing&&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+    MpscRing& operator=(MpscRing&&) = delete;
+
+    bool push(const T& value)
+    {
+        return push(std::span<const T>{&value, 1});
+    }
+
+    // Publishes all values in order, or none of them if they do not fit
+    bool push(std::span<const T> values)
+    {
+        if (values.empty()) {
+            return true;
+        }
+        if (values.size() > _capacity) {
+            _rejected.fetch_add(values.size(), std::memory_order_relaxed);
+            return false;
+        }
+
+        auto position = _tail.load(std::memory_order_relaxed);
+        for (;;) {
+            // Slots are freed in order, so if the last slot of the batch is
+            // free for this lap, all the slots before it are free as well
+            auto last = position + values.size() - 1;
+            auto sequence =
+                slot(last).sequence.load(std::memory_order_acquire);
+            auto difference = (std::intptr_t)sequence - (std::intptr_t)last;
+
+            if (difference == 0) {
+                if (_tail.compare_exchange_weak(
+                        position,
+                        position + values.size(),
+                        std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                _rejected.fetch_add(values.size(), std::memory_order_relaxed);
+                return false;
+            } else {
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        for (const auto& value : values) {
+            auto& target = slot(position);
+            target.value = value;
+            target.sequence.store(position + 1, std::memory_order_release);
+            position++;
+        }
+        _published.fetch_add(values.size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    // Publishes values in order, in batches of at most the capacity, until a
+    // batch does not fit. Returns how many values were published, so the
+    // caller can keep the rest for later without the backlog ever becoming
+    // too large to push.
+    size_t pushBatches(std::span<const T> values)
+    {
+        size_t published = 0;
+        while (published < values.size()) {
+            auto batch = values.subspan(
+                published, std::min(_capacity, values.size() - published));
+            if (!push(batch)) {
+                break;
+            }
+            published += batch.size();
+        }
+        return published;
+    }
+
+    // Passes up to maxCount waiting values to f in publication order. Must
+    // only be called from one thread at a time.
+    template <class F>
+    size_t consume(F&& f, size_t maxCount = SIZE_MAX)
+    {
+        auto waiting = _tail.load(std::memory_order_relaxed) - _head;
+        _highWater = std::max(_highWater, std::min(waiting, _capacity));
+
+        size_t count = 0;
+        while (count < maxCount) {
+            auto& source = slot(_head);
+            if (source.sequence.load(std::memory_order_acquire) != _head + 1) {
+                break;
+            }
+            f(static_cast<const T&>(source.value));
+            source.sequence.store(_head + _capacity, std::memory_order_release);
+            _head++;
+            count++;
+        }
+        _consumed += count;
+        return count;
+    }
+
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    // Safe to call from the consumer thread
+    RingStats stats() const
+    {
+        return {
+            .published = _published.load(std::memory_order_relaxed),
+            .rejected = _rejected.load(std::memory_order_relaxed),
+            .consumed = _consumed,
+            .highWater = _highWater,
+        };
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence {0};
+        T value {};
+    };
+
+    Slot& slot(size_t position)
+    {
+        return _slots[position & (_capacity - 1)];
+    }
+
+    const size_t _capacity;
+    std::unique_ptr<Slot[]> _slots;
+
+    alignas(64) std::atomic<size_t> _tail {0};
+    std::atomic<std::uint64_t> _published {0};
+    std::atomic<std::uint64_t> _rejected {0};
+
+    alignas(64) size_t _head = 0;
+    std::uint64_t _consumed = 0;
+    size_t _highWater = 0;
+};
+
+} // namespace gx
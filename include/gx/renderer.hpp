@@ -8,6 +8,8 @@
 #include <chrono>
 #include <filesystem>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <ostream>
 #include <span>
 #include <string>
@@ -26,16 +28,63 @@ using PixelVector = Vector<int, PixelTag>;
 using PixelPoint = Point<int, PixelTag>;
 using PixelRectangle = Rectangle<int, PixelTag>;
 
+struct Color {
+    uint8_t r = 0;
+    uint8_t g = 0;
+    uint8_t b = 0;
+    uint8_t a = 0;
+};
+
+// Colors of an indexed bitmap, by pixel value
+using Palette = std::vector<Color>;
+
+class Blitter;
+struct CaptureConfig;
+struct CaptureStats;
+class FrameCapture;
+class Image;
+class ScaledCache;
+
 class Bitmap {
 public:
     Bitmap();
 
     PixelVector size() const;
 
+    // Smallest part of the area that holds all of its visible pixels, empty
+    // when everything is transparent. Render targets and text may return
+    // the whole area.
+    PixelRectangle visibleArea(const PixelRectangle& area) const;
+    // Whether every pixel of the area is known to be fully opaque
+    bool opaque(const PixelRectangle& area) const;
+
+    // All 256 colors of a bitmap loaded from an indexed image, empty for
+    // any other bitmap
+    Palette palette() const;
+
 private:
     explicit Bitmap(SDL_Texture* ptr);
+    explicit Bitmap(Image image);
+
+    // Whether pixel information was kept at all
+    bool analyzable() const;
+    // Whether the pixel is visible and whether it is opaque, as two bits.
+    // Takes the width to not query the texture for every pixel.
+    std::uint8_t coverage(int x, int y, int width) const;
 
     std::unique_ptr<SDL_Texture, void(*)(SDL_Texture*)> _ptr;
+    // Lives as long as the texture, to tell scaled copies apart. Only set
+    // for bitmaps that never change, so render targets are never cached.
+    std::shared_ptr<const void> _lifetime;
+    // Pixels for the blitter, which draws without textures
+    std::shared_ptr<Image> _image;
+    // Two bits per pixel for analyzing sprite frames, only kept for loaded
+    // textures, whose pixels are gone after upload
+    std::vector<std::uint8_t> _coverage;
+    // Pixels of indexed bitmaps, shared with their recolored copies, which
+    // also stand in for the alpha channel
+    std::shared_ptr<const std::vector<std::uint8_t>> _indices;
+    std::shared_ptr<const Palette> _palette;
 
     friend class Renderer;
 };
@@ -53,13 +102,6 @@ private:
     friend class Renderer;
 };
 
-struct Color {
-    uint8_t r = 0;
-    uint8_t g = 0;
-    uint8_t b = 0;
-    uint8_t a = 0;
-};
-
 class Font {
 public:
     Font() = default;
@@ -71,12 +113,40 @@ private:
     friend class Renderer;
 };
 
+struct WindowConfig {
+    std::string title = "gx";
+    PixelVector size {1024, 768};
+    bool vsync = true;
+    // Hidden window with the software renderer, on SDL's dummy video driver
+    // unless SDL_VIDEODRIVER says otherwise. For benchmarks and tools that
+    // run without a display.
+    bool headless = false;
+    // Draw with gx's own SIMD blitter into a framebuffer in system memory
+    // and only hand finished frames to SDL. Much faster than SDL's software
+    // renderer on machines without a GPU.
+    bool blitter = false;
+    // Threads rasterizing the blitter's frames, 0 for one per core
+    int blitterThreads = 0;
+    // Texture memory for sprite frames scaled up by whole zoom factors
+    // ahead of time, 0 to always scale while drawing. Unused by the
+    // blitter, which scales such frames without filtering anyway.
+    size_t scaledCacheBytes = 64 * 1024 * 1024;
+    // Copy only the areas that changed to the window surface, with
+    // SDL_UpdateWindowSurfaceRects, and have Box redraw only those. Needs
+    // the blitter, whose framebuffer keeps the rest of the last frame.
+    bool dirtyRectangles = false;
+};
+
 class Renderer {
 public:
-    Renderer();
+    explicit Renderer(const WindowConfig& config = {});
 
     Bitmap loadBitmap(const std::filesystem::path& path) const;
     Bitmap loadBitmap(const std::span<const std::byte>& data) const;
+    // Copy of an indexed bitmap with other colors, such as team colors.
+    // The pixels are shared; SDL still needs a texture of its own, while
+    // the blitter only keeps the new palette.
+    Bitmap recolor(const Bitmap& bitmap, const Palette& palette) const;
 
     static Cursor loadCursor(const std::filesystem::path& path, int x, int y);
     static void setCursor(Cursor& cursor);
@@ -87,25 +157,97 @@ public:
         const Color& color,
         int maxLength = 0);
 
+    // Opaque frames are copied without blending, which is cheaper. At whole
+    // zoom factors, frames are scaled once and then drawn from a cache.
     void draw(
         const Bitmap& bitmap,
         const PixelRectangle& frame,
         const ScreenPoint& position,
-        float zoom = 1.f);
+        float zoom = 1.f,
+        bool opaque = false);
 
     void drawRectangle(const ScreenRectangle& rectangle, const Color& color);
 
+    // Transparent bitmap that can be rendered into after setTarget. Its
+    // contents are expected to have premultiplied alpha.
+    Bitmap createTarget(const PixelVector& size) const;
+    // Redirects drawing into the target, or back into the window for nullptr
+    void setTarget(Bitmap* target);
+    void setClip(const std::optional<ScreenRectangle>& clip);
+    // As last set
+    const std::optional<ScreenRectangle>& clip() const;
+    // Replaces the area with transparent pixels
+    void erase(const ScreenRectangle& area);
+
+    // Memory for containers that only live while a frame is drawn
+    std::pmr::memory_resource* frameMemory() const;
+    void setFrameMemory(std::pmr::memory_resource* memory);
+
     bool processEvent(const SDL_Event& e);
     void clear();
     void present();
+    // Presents only the areas, the rest of the window keeps showing the
+    // last frame. Without dirty rectangles, presents everything.
+    void present(std::span<const PixelRectangle> areas);
+    bool dirtyRectangles() const;
+
+    // Records every presented frame from now on, replacing any earlier
+    // recording. Frames are read back right before presenting and encoded
+    // on another thread; frames Box skips because nothing changed are not
+    // recorded.
+    void startCapture(const CaptureConfig& config);
+    // Waits until the recorded frames are written
+    void stopCapture();
+    // Of the current or last recording
+    CaptureStats captureStats() const;
 
     const ScreenVector& windowSize() const;
     ScreenRectangle windowArea() const;
+    // False while the window is minimized or hidden
+    bool visible() const;
+    // Refresh rate of the display showing the window, 0 if unknown
+    int refreshRate() const;
 
 private:
+    // Takes ownership of the surface. Text is never cut into sprite frames,
+    // so it is not analyzed.
+    Bitmap surfaceBitmap(SDL_Surface* surface, bool analyze = true) const;
+    // Static texture in the renderer's own format, with premultiplied alpha
+    // where the backend can blend it. Fills in the coverage of its pixels
+    // if asked to.
+    SDL_Texture* createTexture(
+        SDL_Surface* surface, std::vector<std::uint8_t>* coverage) const;
+    Bitmap indexedBitmap(
+        const PixelVector& size,
+        std::shared_ptr<const std::vector<std::uint8_t>> indices,
+        Palette palette) const;
+    void presentFramebuffer();
+    void presentWindowSurface(std::span<const PixelRectangle> areas);
+    void captureFrame();
+
     ScreenVector _windowSize;
+    std::pmr::memory_resource* _frameMemory =
+        std::pmr::new_delete_resource();
     std::unique_ptr<SDL_Window, void(*)(SDL_Window*)> _window;
     std::unique_ptr<SDL_Renderer, void(*)(SDL_Renderer*)> _renderer;
+    std::unique_ptr<Blitter, void(*)(Blitter*)> _blitter;
+    // Loaded pixels are converted to this before upload
+    Uint32 _textureFormat = SDL_PIXELFORMAT_ARGB8888;
+    std::unique_ptr<ScaledCache, void(*)(ScaledCache*)> _scaledCache;
+    // Streaming texture the blitter's framebuffer is uploaded to
+    Bitmap _framebufferTexture;
+    std::optional<ScreenRectangle> _clip;
+
+    // Window surface that dirty rectangles were last copied to, which
+    // shows the whole last frame unless it was replaced or exposed
+    bool _dirtyRectangles = false;
+    SDL_Surface* _windowSurface = nullptr;
+    PixelVector _windowSurfaceSize;
+    bool _exposed = false;
+    // Headless windows start out hidden, but are drawn anyway
+    bool _visible = true;
+
+    std::unique_ptr<FrameCapture, void(*)(FrameCapture*)> _capture;
 };
 
 } // namespace gx
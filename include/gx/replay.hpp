@@ -0,0 +1,55 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+namespace gx {
+
+// Input of one frame and the number of simulation steps it ran. Replaying
+// both makes a deterministic simulation repeat itself exactly.
+struct ReplayFrame {
+    std::uint64_t index = 0;
+    int steps = 0;
+    std::vector<SDL_Event> events;
+};
+
+// Writes frames to a file as they happen. Only events without pointers to
+// SDL-owned memory (quit, window, keyboard, text and mouse events) are
+// kept. The file is only valid on the platform and SDL version it was
+// recorded with.
+class ReplayRecorder {
+public:
+    explicit ReplayRecorder(const std::filesystem::path& path);
+
+    void event(const SDL_Event& e);
+    // Writes the events since the previous frame together with the steps
+    void frame(int steps);
+
+private:
+    std::ofstream _output;
+    std::uint64_t _frame = 0;
+    std::vector<SDL_Event> _events;
+};
+
+class ReplayPlayer {
+public:
+    explicit ReplayPlayer(const std::filesystem::path& path);
+    explicit ReplayPlayer(std::vector<ReplayFrame> frames);
+
+    // Moves to the next frame, returns false after the last one
+    bool next();
+
+    const ReplayFrame& frame() const;
+
+private:
+    std::vector<ReplayFrame> _frames;
+    size_t _next = 0;
+};
+
+} // namespace gx
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <gx/renderer.hpp>
+
+#include <SDL.h>
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+namespace gx {
+
+// Copies of sprite frames scaled up by whole factors, so that SDL draws
+// them at their own size instead of rescaling them on every call. Copies
+// are made on first use; once they take up more than the capacity, the
+// least recently drawn ones go first.
+//
+// Textures are told apart by an owner that lives as long as they do, so
+// copies of destroyed textures are never handed out for new textures that
+// happen to reuse the address.
+class ScaledCache {
+public:
+    // In bytes of texture memory, 0 disables the cache
+    explicit ScaledCache(size_t capacity);
+
+    // Scaled copy of the frame, or nullptr when the zoom is not a whole
+    // factor above 1, the copy would not fit or the renderer cannot draw
+    // into textures
+    SDL_Texture* find(
+        SDL_Renderer* renderer,
+        SDL_Texture* texture,
+        const std::shared_ptr<const void>& owner,
+        const PixelRectangle& frame,
+        float zoom);
+
+    // Needed when the renderer loses the contents of its target textures
+    void clear();
+
+    // Bytes taken up by the copies
+    size_t size() const;
+
+private:
+    struct Key {
+        const SDL_Texture* texture = nullptr;
+        PixelRectangle frame;
+        int zoom = 0;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        Key key;
+        std::weak_ptr<const void> owner;
+        std::unique_ptr<SDL_Texture, void(*)(SDL_Texture*)> texture;
+        size_t bytes = 0;
+    };
+
+    void erase(std::list<Entry>::iterator entry);
+
+    size_t _capacity = 0;
+    size_t _size = 0;
+    // Most recently drawn first
+    std::list<Entry> _entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> _index;
+};
+
+} // namespace gx
@@ -2,14 +2,20 @@
 
 #include <gx/geometry.hpp>
 #include <gx/id.hpp>
+#include <gx/mpsc_ring.hpp>
 #include <gx/renderer.hpp>
 #include <gx/sprite.hpp>
+#include <gx/triple_buffer.hpp>
 #include <gx/ui.hpp>
 
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 
 namespace gx {
@@ -35,30 +41,139 @@ struct Camera {
     Object* follow = nullptr;
 };
 
+// Fixed-size scene change that game threads can queue for the scene's thread.
+// Objects are addressed by keys that the caller picks when spawning them.
+struct SceneCommand {
+    enum class Type : std::uint8_t {
+        Spawn,
+        Move,
+        Kill,
+        MoveCamera,
+        FollowWithCamera,
+    };
+
+    Type type = Type::Move;
+    std::uint64_t key = 0;
+    // Spawn only
+    const Sprite* sprite = nullptr;
+    // Spawn, Move and MoveCamera
+    WorldPoint position;
+};
+
+using SceneCommandQueue = MpscRing<SceneCommand>;
+
+// Immutable copy of what a Scene draws, handed from the simulation thread to
+// the render thread
+struct SceneSnapshot {
+    struct Sprite {
+        const SpriteFrame* frame = nullptr;
+        WorldPoint position;
+    };
+
+    Camera camera;
+    std::vector<Sprite> sprites;
+};
+
 class Scene : public Widget {
 public:
     Camera& camera();
 
     void update(float delta) override;
-    void render(Renderer& renderer, const ScreenRectangle& area) const override;
+    void render(Renderer& renderer) const override;
+    bool retained() const override;
+    bool simulated() const override;
+    void pipeline(bool enabled) override;
+    // Areas of sprites that moved, appeared, disappeared or changed frame,
+    // or the whole scene when the camera moved
+    void damage(Damage& damage) override;
+    // Next animation frame of any object, only without pipelining
+    std::optional<float> nextChange() const override;
 
     void setupCamera(const WorldPoint& center, float unitPixelSize, float zoom);
     void cameraFollow(Object* object);
+    // Draws sprites unscaled into an offscreen target snapped to whole art
+    // pixels, then scales the target up once. Needs an integer zoom, other
+    // zooms are drawn directly.
+    void lowResolution(bool enabled);
 
     Object* spawn(const Sprite& sprite, const WorldPoint& position);
 
+    // Spawn commands for a key that is still alive are ignored
+    void apply(const SceneCommand& command);
+    // Applies all queued commands, returns how many there were
+    size_t apply(SceneCommandQueue& queue);
+    // Spawn commands ignored so far because their key was taken
+    size_t rejectedSpawns() const;
+
     void clickAction(std::function<void(const WorldPoint&)> action);
 
-    Widget* locate(
-        const ScreenRectangle& area, const ScreenPoint& point) override;
+    std::optional<ScreenRectangle> hitArea() const override;
 
     void onPress(
         const ScreenRectangle& area, const ScreenPoint& point) override;
 
+protected:
+    void onLayout(const ScreenRectangle& area) override;
+
 private:
+    // Where a sprite was drawn on screen, as of the last damage call
+    struct DrawnSprite {
+        const SpriteFrame* frame = nullptr;
+        ScreenRectangle area;
+
+        bool operator==(const DrawnSprite&) const = default;
+    };
+
+    // Where sprites go in the low resolution target, in art pixels, and
+    // where the target goes on screen
+    struct LowResolutionLayout {
+        PixelVector size;
+        int scale = 1;
+        // Art pixel position of the target's top left corner in the world
+        ScreenPoint origin;
+        // Screen position of the target's top left corner
+        ScreenPoint screenOrigin;
+
+        // Inside the target
+        ScreenRectangle frameArea(
+            const SpriteFrame& frame,
+            const WorldPoint& position,
+            const Camera& camera) const;
+        // Covered on screen by an area of the target
+        ScreenRectangle screenArea(const ScreenRectangle& area) const;
+    };
+
+    void publish();
+    const Camera& visibleCamera() const;
+    // Zoom factor of the low resolution target, 0 when drawing directly
+    int lowResolutionScale(const Camera& camera) const;
+    LowResolutionLayout lowResolutionLayout(
+        const Camera& camera, int scale) const;
+    template <class F>
+    void forEachSprite(const SceneSnapshot* snapshot, F&& f) const;
+    void renderLowResolution(
+        Renderer& renderer, const Camera& camera, int scale,
+        const SceneSnapshot* snapshot) const;
+
+    ScreenRectangle _area;
     Camera _camera;
     std::vector<std::unique_ptr<Object>> _objects;
     std::function<void(const WorldPoint&)> _clickAction;
+    std::unique_ptr<TripleBuffer<SceneSnapshot>> _snapshots;
+    std::unordered_map<std::uint64_t, Object*> _keyedObjects;
+    size_t _rejectedSpawns = 0;
+    bool _lowResolution = false;
+    mutable Bitmap _lowResolutionTarget;
+    mutable PixelVector _lowResolutionSize;
+
+    // Snapshot that damage reported on, for render to draw
+    const SceneSnapshot* _frameSnapshot = nullptr;
+    std::vector<DrawnSprite> _drawnSprites;
+    std::vector<DrawnSprite> _spritesToDraw;
+    // Nothing when the next frame has to be drawn whole
+    std::optional<Camera> _drawnCamera;
+    ScreenRectangle _drawnArea;
+    int _drawnScale = 0;
 };
 
 } // namespace gx
@@ -2,16 +2,44 @@
 
 #include <gx/renderer.hpp>
 
+#include <optional>
 #include <vector>
 
 namespace gx {
 
 struct SpriteFrame {
+    // From the middle of the untrimmed frame to the middle of the drawn
+    // one, in bitmap pixels
+    ScreenVector offset() const;
+
     const Bitmap* bitmap = nullptr;
+    // Part of the bitmap that is drawn, without transparent borders
     PixelRectangle frame;
     float duration = 0.f;
+    // Size before trimming, and where the trimmed frame starts within it
+    PixelVector size;
+    PixelVector trim;
+    // Drawn without blending
+    bool opaque = false;
 };
 
+// Frame of the bitmap with its transparent borders trimmed away, flagged
+// as opaque when no pixel of it needs blending
+SpriteFrame analyzeFrame(
+    const Bitmap& bitmap, const PixelRectangle& frame, float duration);
+
+// Screen area that drawFrame covers, before the renderer rounds it to
+// whole pixels
+ScreenRectangle frameArea(
+    const SpriteFrame& frame, const ScreenPoint& position, float zoom);
+
+// Draws the frame where its untrimmed middle would be
+void drawFrame(
+    Renderer& renderer,
+    const SpriteFrame& frame,
+    const ScreenPoint& position,
+    float zoom);
+
 struct Sprite {
     std::vector<SpriteFrame> frames;
     float zoom = 1.f;
@@ -33,11 +61,17 @@ public:
         return _sprite != nullptr;
     }
 
+    const SpriteFrame& spriteFrame() const;
     const Bitmap& bitmap() const;
     const PixelRectangle& frame() const;
+    // Untrimmed size of the frame on screen
     ScreenVector size() const;
 
-    void update(float delta);
+    // Returns whether the displayed frame changed
+    bool update(float delta);
+    // Seconds of updates until the displayed frame changes, nothing for a
+    // single frame
+    std::optional<float> timeToNextFrame() const;
     void draw(Renderer& renderer, const ScreenPoint& position) const;
 
     void noloop();
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <ostream>
+#include <string>
+
+// GX_TRACE_ZONE("name") records the time until the end of the enclosing
+// scope, and GX_TRACE_FRAME() marks the end of a frame. Both compile to
+// nothing unless GX_TRACE is defined (the GX_TRACE CMake option). Zone names
+// must be string literals.
+#ifdef GX_TRACE
+    #define GX_TRACE_CONCAT_IMPL(a, b) a##b
+    #define GX_TRACE_CONCAT(a, b) GX_TRACE_CONCAT_IMPL(a, b)
+    #define GX_TRACE_ZONE(name) \
+        const ::gx::TraceZone GX_TRACE_CONCAT(gxTraceZone, __LINE__) {name}
+    #define GX_TRACE_FRAME() ::gx::traceFrame()
+#else
+    #define GX_TRACE_ZONE(name) static_cast<void>(0)
+    #define GX_TRACE_FRAME() static_cast<void>(0)
+#endif
+
+namespace gx {
+
+struct TraceConfig {
+    // A frame longer than this dumps the trace of the last frames, 0 turns
+    // hitch capture off
+    float budgetSeconds = 0.f;
+    // Number of frames in a dump, including the slow one
+    size_t frames = 8;
+    // Dumps go to gx-hitch-<frame>.json in this directory
+    std::filesystem::path directory = ".";
+};
+
+void configureTrace(const TraceConfig& config);
+
+struct TraceStats {
+    size_t writtenDumps = 0;
+    // Hitches that came while earlier dumps were still waiting to be written
+    size_t droppedDumps = 0;
+    size_t failedDumps = 0;
+    // Of the last failed dump
+    std::string lastError;
+};
+
+// Zones are kept in a ring buffer per thread, so a zone costs two counter
+// reads and a few stores. The oldest zones are overwritten.
+class TraceZone {
+public:
+    explicit TraceZone(const char* name)
+        : _name(name)
+        , _start(SDL_GetPerformanceCounter())
+    { }
+
+    ~TraceZone();
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone(TraceZone&&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+    TraceZone& operator=(TraceZone&&) = delete;
+
+private:
+    const char* _name;
+    Uint64 _start;
+};
+
+// Ends a frame, and dumps the last frames if it was over budget. The zones
+// are copied right away and written by a thread of its own; failures to
+// write are counted in traceStats rather than thrown. Call from one thread
+// only.
+void traceFrame();
+
+TraceStats traceStats();
+
+// Writes the zones of all threads that are still in their ring buffers as
+// Chrome trace event JSON, loadable in chrome://tracing or Perfetto
+void writeTrace(std::ostream& output);
+
+} // namespace gx
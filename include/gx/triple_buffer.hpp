@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace gx {
+
+// Lock-free single-producer single-consumer handoff of the latest value. The
+// writer fills back() and publishes it; the reader always gets the most
+// recently published value, and neither side ever waits for the other.
+template <class T>
+class TripleBuffer {
+public:
+    T& back()
+    {
+        return _buffers[_back];
+    }
+
+    void publish()
+    {
+        auto previous = _middle.exchange(
+            static_cast<std::uint8_t>(_back | freshBit),
+            std::memory_order_acq_rel);
+        _back = previous & indexMask;
+    }
+
+    // Latest published value, or the previous one if nothing new was
+    // published since
+    const T& read()
+    {
+        if (_middle.load(std::memory_order_relaxed) & freshBit) {
+            auto previous =
+                _middle.exchange(_front, std::memory_order_acq_rel);
+            _front = previous & indexMask;
+        }
+        return _buffers[_front];
+    }
+
+private:
+    static constexpr std::uint8_t indexMask = 0b011;
+    static constexpr std::uint8_t freshBit = 0b100;
+
+    std::array<T, 3> _buffers;
+    alignas(64) std::uint8_t _back = 0;
+    alignas(64) std::atomic<std::uint8_t> _middle {1};
+    alignas(64) std::uint8_t _front = 2;
+};
+
+} // namespace gx
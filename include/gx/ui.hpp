@@ -1,5 +1,6 @@
 #pragma once
 
+#include <gx/damage.hpp>
 #include <gx/geometry.hpp>
 #include <gx/renderer.hpp>
 #include <gx/sprite.hpp>
@@ -7,9 +8,11 @@
 
 #include <SDL.h>
 
+#include <algorithm>
 #include <concepts>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -52,17 +55,81 @@ inline constexpr ScreenPoint combine(
     };
 }
 
+// Shared by all widgets of a Box, so that it can tell whether any of them
+// needs a layout or render pass without visiting each one
+struct UiDirtyFlags {
+    bool layout = true;
+    bool render = true;
+};
+
 class Widget {
 public:
     virtual ~Widget() = default;
 
+    // Resolves the widget against its parent area, but only if the area
+    // changed or invalidateLayout was called since the last time
+    void layout(const ScreenRectangle& area)
+    {
+        if (_layoutDirty || area != _parentArea) {
+            _parentArea = area;
+            _layoutDirty = false;
+            _renderDirty = true;
+            onLayout(area);
+        }
+    }
+
     virtual void update(float delta) {}
-    virtual void render(
-        Renderer& renderer, const ScreenRectangle& area) const = 0;
-    virtual Widget* locate(
-        const ScreenRectangle& /*area*/, const ScreenPoint& /*point*/)
+    virtual void render(Renderer& renderer) const = 0;
+
+    // Retained widgets are drawn into Box's cached UI layer, over all other
+    // widgets, and only re-rendered after invalidateRender. Only return true
+    // if every change to what render draws calls invalidateRender; other
+    // widgets are drawn every frame.
+    virtual bool retained() const
+    {
+        return false;
+    }
+
+    // Simulated widgets are updated on the simulation thread when Box::run is
+    // pipelined. Box then calls pipeline(true), after which the widget must
+    // publish snapshots from update and only render and handle input from
+    // those.
+    virtual bool simulated() const
+    {
+        return false;
+    }
+
+    virtual void pipeline(bool /*enabled*/) {}
+
+    // Screen area the widget draws into. Valid after layout.
+    virtual ScreenRectangle renderArea() const
     {
-        return nullptr;
+        return _parentArea;
+    }
+
+    // Adds the screen areas that look different since the last frame, when
+    // Box presents dirty rectangles. Only asked of widgets that are not
+    // retained, once per frame before they render, possibly several times
+    // with different clip rectangles. They must draw the state they
+    // reported here.
+    virtual void damage(Damage& damage)
+    {
+        damage.add(renderArea());
+    }
+
+    // Seconds until the widget looks different without input, such as at
+    // its next animation frame. Nothing if only input or the game change
+    // it. Asked on the thread that updates the widget.
+    virtual std::optional<float> nextChange() const
+    {
+        return std::nullopt;
+    }
+
+    // Screen area that receives mouse events, or nothing if the widget
+    // ignores the mouse. Valid after layout.
+    virtual std::optional<ScreenRectangle> hitArea() const
+    {
+        return std::nullopt;
     }
 
     virtual void onFocus() {}
@@ -72,6 +139,44 @@ public:
     virtual void onRelease() {}
     virtual void onActivate() {}
     virtual void onDrag(const ScreenVector&) {}
+
+protected:
+    // Cache screen rectangles resolved from UI coordinates here
+    virtual void onLayout(const ScreenRectangle& /*area*/) {}
+
+    void invalidateLayout()
+    {
+        for (auto* widget = this; widget; widget = widget->_parent) {
+            widget->_layoutDirty = true;
+            widget->_renderDirty = true;
+        }
+        if (_boxDirty) {
+            _boxDirty->layout = true;
+            _boxDirty->render = true;
+        }
+    }
+
+    void invalidateRender()
+    {
+        for (auto* widget = this; widget; widget = widget->_parent) {
+            widget->_renderDirty = true;
+        }
+        if (_boxDirty) {
+            _boxDirty->render = true;
+        }
+    }
+
+private:
+    ScreenRectangle _parentArea;
+    bool _layoutDirty = true;
+    bool _renderDirty = true;
+    // Where the widget was last drawn into the UI layer
+    std::optional<ScreenRectangle> _renderedArea;
+    Widget* _parent = nullptr;
+    UiDirtyFlags* _boxDirty = nullptr;
+
+    friend class Box;
+    friend class Panel;
 };
 
 class Button : public Widget {
@@ -79,36 +184,42 @@ public:
     Button* position(const UiCoordinate& x, const UiCoordinate& y)
     {
         _position = {x, y};
+        invalidateLayout();
         return this;
     }
 
     Button* size(const UiCoordinate& w, const UiCoordinate& h)
     {
         _size = {w, h};
+        invalidateLayout();
         return this;
     }
 
     Button* color(const Color& color)
     {
         _color = color;
+        invalidateRender();
         return this;
     }
 
     Button* buttonSprite(const Sprite& sprite)
     {
         _buttonAnimation = Animation{sprite};
+        invalidateLayout();
         return this;
     }
 
     Button* pressedButtonSprite(const Sprite& sprite)
     {
         _pressedButtonAnimation = Animation{sprite};
+        invalidateLayout();
         return this;
     }
 
     Button* textSprite(const Sprite& sprite)
     {
         _textAnimation = Animation{sprite};
+        invalidateRender();
         return this;
     }
 
@@ -118,42 +229,91 @@ public:
         return this;
     }
 
-    void render(Renderer& renderer, const ScreenRectangle& area) const override
+    bool retained() const override
     {
-        auto screenPosition = combine(area, _position);
+        return true;
+    }
 
+    // Only the shown button sprite animates, the other one waits
+    void update(float delta) override
+    {
+        for (auto* animation : {&buttonAnimation(), &_textAnimation}) {
+            if (*animation && animation->update(delta)) {
+                invalidateRender();
+            }
+        }
+    }
+
+    std::optional<float> nextChange() const override
+    {
+        auto next = std::optional<float>{};
+        for (const auto* animation : {&buttonAnimation(), &_textAnimation}) {
+            if (auto change = *animation ?
+                    animation->timeToNextFrame() : std::nullopt) {
+                next = std::min(next.value_or(*change), *change);
+            }
+        }
+        return next;
+    }
+
+    void render(Renderer& renderer) const override
+    {
         if (buttonAnimation()) {
-            buttonAnimation().draw(renderer, screenPosition);
+            buttonAnimation().draw(renderer, _screenPosition);
         } else {
-            auto screenArea = combine(area, uiArea());
-            renderer.drawRectangle(screenArea, _color);
+            renderer.drawRectangle(_screenArea, _color);
         }
 
         if (_textAnimation) {
             if (_pressed) {
                 _textAnimation.draw(
-                    renderer, screenPosition + ScreenVector{1, 1});
+                    renderer, _screenPosition + ScreenVector{1, 1});
             } else {
-                _textAnimation.draw(renderer, screenPosition);
+                _textAnimation.draw(renderer, _screenPosition);
             }
         }
     }
 
-    Widget* locate(
-        const ScreenRectangle& area, const ScreenPoint& point) override
+    ScreenRectangle renderArea() const override
+    {
+        if (!_textAnimation) {
+            return _screenArea;
+        }
+
+        // The text is shifted by a pixel when pressed
+        auto textArea = ScreenRectangle::atPosition(
+            _screenPosition, _textAnimation.size());
+        textArea.w += 1;
+        textArea.h += 1;
+
+        auto x = std::min(_screenArea.x, textArea.x);
+        auto y = std::min(_screenArea.y, textArea.y);
+        return {
+            .x = x,
+            .y = y,
+            .w = std::max(
+                _screenArea.x + _screenArea.w, textArea.x + textArea.w) - x,
+            .h = std::max(
+                _screenArea.y + _screenArea.h, textArea.y + textArea.h) - y,
+        };
+    }
+
+    std::optional<ScreenRectangle> hitArea() const override
     {
-        auto screenArea = combine(area, uiArea());
-        return screenArea.contains(point) ? this : nullptr;
+        return _screenArea;
     }
 
+    // The pressed sprite may differ in size, so pressing changes the layout
     void onPress(const ScreenRectangle&, const ScreenPoint&) override
     {
         _pressed = true;
+        invalidateLayout();
     }
 
     void onRelease() override
     {
         _pressed = false;
+        invalidateLayout();
     }
 
     void onActivate() override
@@ -161,12 +321,24 @@ public:
         _action();
     }
 
+protected:
+    void onLayout(const ScreenRectangle& area) override
+    {
+        _screenPosition = combine(area, _position);
+        _screenArea = combine(area, uiArea());
+    }
+
 private:
     const Animation& buttonAnimation() const
     {
         return _pressed ? _pressedButtonAnimation : _buttonAnimation;
     }
 
+    Animation& buttonAnimation()
+    {
+        return _pressed ? _pressedButtonAnimation : _buttonAnimation;
+    }
+
     UiRectangle uiArea() const
     {
         if (auto animation = buttonAnimation(); animation) {
@@ -189,6 +361,9 @@ private:
     Animation _textAnimation;
     bool _pressed = false;
     std::function<void()> _action = []{};
+
+    ScreenPoint _screenPosition;
+    ScreenRectangle _screenArea;
 };
 
 class Panel : public Widget {
@@ -197,13 +372,31 @@ public:
     T* createWidget(Args&&... args)
     {
         _widgets.push_back(std::make_unique<T>(std::forward<Args>(args)...));
+        _widgets.back()->_parent = this;
+        _widgets.back()->_boxDirty = _boxDirty;
+        invalidateLayout();
         return reinterpret_cast<T*>(_widgets.back().get());
     }
 
-    void render(Renderer& renderer, const ScreenRectangle& area) const override
+    // Retained as long as everything in it is
+    bool retained() const override
+    {
+        return std::ranges::all_of(_widgets, &Widget::retained);
+    }
+
+    void render(Renderer& renderer) const override
+    {
+        for (const auto& widget : _widgets) {
+            widget->render(renderer);
+        }
+    }
+
+protected:
+    void onLayout(const ScreenRectangle& area) override
     {
+        auto screenArea = combine(area, _location);
         for (const auto& widget : _widgets) {
-            widget->render(renderer, combine(area, _location));
+            widget->layout(screenArea);
         }
     }
 
@@ -0,0 +1,144 @@
+#include <gx/latency.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace gx {
+
+namespace {
+
+bool isInput(const SDL_Event& e)
+{
+    switch (e.type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_TEXTINPUT:
+        case SDL_MOUSEMOTION:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+        case SDL_MOUSEWHEEL:
+        case SDL_FINGERDOWN:
+        case SDL_FINGERUP:
+        case SDL_FINGERMOTION:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+LatencyMeter::LatencyMeter()
+    : _frequency(SDL_GetPerformanceFrequency())
+{
+    _pendingInputs.reserve(256);
+}
+
+void LatencyMeter::markInput(const SDL_Event& e)
+{
+    if (!isInput(e)) {
+        return;
+    }
+
+    // Event timestamps are SDL ticks in milliseconds, so carry the event's
+    // age over to the performance counter
+    auto now = SDL_GetPerformanceCounter();
+    auto ageMs = (Uint64)(Uint32)(SDL_GetTicks() - e.common.timestamp);
+    auto ageTicks = std::min(now, ageMs * _frequency / 1000);
+    _pendingInputs.push_back(now - ageTicks);
+}
+
+void LatencyMeter::markPresent()
+{
+    if (_pendingInputs.empty()) {
+        return;
+    }
+
+    auto now = SDL_GetPerformanceCounter();
+    for (auto input : _pendingInputs) {
+        auto seconds = (double)(now - input) / (double)_frequency;
+        auto bucket = std::min(
+            (size_t)(seconds / bucketSeconds), bucketCount - 1);
+        _histogram[bucket]++;
+        _samples++;
+        _totalSeconds += seconds;
+        _maxSeconds = std::max(_maxSeconds, seconds);
+    }
+    _pendingInputs.clear();
+}
+
+LatencyStats LatencyMeter::stats() const
+{
+    auto stats = LatencyStats{
+        .samples = _samples,
+        .maxSeconds = _maxSeconds,
+    };
+    if (_samples == 0) {
+        return stats;
+    }
+    stats.meanSeconds = _totalSeconds / (double)_samples;
+
+    // Upper edge of the bucket holding the percentile, but never above the
+    // largest sample
+    auto percentile = [this] (double fraction) {
+        auto rank = (size_t)std::ceil(fraction * (double)_samples);
+        size_t seen = 0;
+        for (size_t i = 0; i < bucketCount; i++) {
+            seen += _histogram[i];
+            if (seen >= rank) {
+                return std::min(
+                    (double)(i + 1) * bucketSeconds, _maxSeconds);
+            }
+        }
+        return _maxSeconds;
+    };
+    stats.p50Seconds = percentile(0.50);
+    stats.p95Seconds = percentile(0.95);
+    stats.p99Seconds = percentile(0.99);
+    return stats;
+}
+
+PresentPredictor::PresentPredictor(int refreshRate)
+    : _frequency(SDL_GetPerformanceFrequency())
+    , _period(_frequency / (Uint64)(refreshRate > 0 ? refreshRate : 60))
+{ }
+
+void PresentPredictor::markLatch()
+{
+    _lastLatch = SDL_GetPerformanceCounter();
+}
+
+void PresentPredictor::markPresent()
+{
+    _lastPresent = SDL_GetPerformanceCounter();
+    if (_lastLatch != 0) {
+        auto work = (double)(_lastPresent - _lastLatch);
+        _workTicks = std::max(work, _workTicks * 0.98);
+    }
+}
+
+Uint64 PresentPredictor::latchDeadline(float marginSeconds) const
+{
+    auto now = SDL_GetPerformanceCounter();
+    if (_lastPresent == 0) {
+        return now;
+    }
+
+    auto lead = (Uint64)_workTicks +
+        (Uint64)(marginSeconds * (float)_frequency);
+    // Work that cannot fit into a refresh period has no vsync to aim for
+    if (lead >= _period) {
+        return now;
+    }
+
+    // Presents return at vsync, so the next one is a whole number of periods
+    // after the last. If the latch point for it has passed, the frame would
+    // block until the one after anyway.
+    auto deadline = _lastPresent + _period - lead;
+    if (deadline < now) {
+        deadline += (now - deadline + _period - 1) / _period * _period;
+    }
+    return deadline;
+}
+
+} // namespace gx
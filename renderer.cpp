@@ -1,9 +1,16 @@
 #include <gx/renderer.hpp>
 
+#include <gx/blitter.hpp>
+#include <gx/capture.hpp>
 #include <gx/error.hpp>
+#include <gx/scaled_cache.hpp>
+#include <gx/trace.hpp>
 
 #include <SDL_image.h>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <utility>
 
 #include <iostream>
@@ -12,6 +19,144 @@ namespace gx {
 
 namespace {
 
+SDL_Rect enclosingRect(const ScreenRectangle& rectangle)
+{
+    auto x = (int)std::floor(rectangle.x);
+    auto y = (int)std::floor(rectangle.y);
+    return {
+        .x = x,
+        .y = y,
+        .w = (int)std::ceil(rectangle.x + rectangle.w) - x,
+        .h = (int)std::ceil(rectangle.y + rectangle.h) - y,
+    };
+}
+
+PixelRectangle enclosingPixels(const ScreenRectangle& rectangle)
+{
+    auto rect = enclosingRect(rectangle);
+    return {rect.x, rect.y, rect.w, rect.h};
+}
+
+// Colors are written as they are, like SDL does without a draw blend mode
+std::uint32_t packColor(const Color& color)
+{
+    return (std::uint32_t)color.a << 24 | (std::uint32_t)color.r << 16 |
+        (std::uint32_t)color.g << 8 | color.b;
+}
+
+// Bits of Bitmap::_coverage, four pixels to a byte
+constexpr std::uint8_t visibleBit = 1;
+constexpr std::uint8_t opaqueBit = 2;
+
+std::uint8_t coverageBits(std::uint8_t alpha)
+{
+    return alpha == 0 ? 0 : alpha == 255 ? visibleBit | opaqueBit : visibleBit;
+}
+
+// Coverage of every pixel of an ARGB8888 surface, row by row
+std::vector<std::uint8_t> coverageMask(const SDL_Surface* surface)
+{
+    auto coverage =
+        std::vector<std::uint8_t>(((size_t)surface->w * surface->h + 3) / 4);
+    size_t i = 0;
+    for (int y = 0; y < surface->h; y++) {
+        const auto* row = reinterpret_cast<const std::uint32_t*>(
+            static_cast<const std::uint8_t*>(surface->pixels) +
+            (ptrdiff_t)y * surface->pitch);
+        for (int x = 0; x < surface->w; x++, i++) {
+            coverage[i / 4] |= (std::uint8_t)(
+                coverageBits((std::uint8_t)(row[x] >> 24)) << (i % 4 * 2));
+        }
+    }
+    return coverage;
+}
+
+// Blending for colors already multiplied by their alpha, as textures and
+// render targets hold them
+SDL_BlendMode premultipliedBlendMode()
+{
+    return SDL_ComposeCustomBlendMode(
+        SDL_BLENDFACTOR_ONE,
+        SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+        SDL_BLENDOPERATION_ADD,
+        SDL_BLENDFACTOR_ONE,
+        SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+        SDL_BLENDOPERATION_ADD);
+}
+
+// First format with alpha that the renderer takes without converting
+Uint32 nativeTextureFormat(SDL_Renderer* renderer)
+{
+    if (!renderer) {
+        return SDL_PIXELFORMAT_ARGB8888;
+    }
+    auto info = SDL_RendererInfo{};
+    sdlCheck(SDL_GetRendererInfo(renderer, &info));
+    for (Uint32 i = 0; i < info.num_texture_formats; i++) {
+        auto format = info.texture_formats[i];
+        if (!SDL_ISPIXELFORMAT_FOURCC(format) &&
+                SDL_BYTESPERPIXEL(format) == 4 &&
+                SDL_ISPIXELFORMAT_ALPHA(format)) {
+            return format;
+        }
+    }
+    return SDL_PIXELFORMAT_ARGB8888;
+}
+
+void destroyBlitter(Blitter* blitter)
+{
+    delete blitter;
+}
+
+void destroyScaledCache(ScaledCache* cache)
+{
+    delete cache;
+}
+
+void destroyFrameCapture(FrameCapture* capture)
+{
+    delete capture;
+}
+
+SDL_Window* createWindow(const WindowConfig& config)
+{
+    // An environment variable still takes precedence over the hint
+    if (config.headless) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    }
+
+    return sdlCheck(SDL_CreateWindow(
+        config.title.c_str(),
+        SDL_WINDOWPOS_UNDEFINED,
+        SDL_WINDOWPOS_UNDEFINED,
+        config.size.x,
+        config.size.y,
+        config.headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_RESIZABLE));
+}
+
+// Dirty rectangles go straight to the window surface, which SDL does not
+// allow next to a renderer
+SDL_Renderer* createRenderer(SDL_Window* window, const WindowConfig& config)
+{
+    if (config.dirtyRectangles) {
+        if (!config.blitter) {
+            throw Error{"dirty rectangles need the blitter"};
+        }
+        return nullptr;
+    }
+
+    auto flags = Uint32{SDL_RENDERER_ACCELERATED};
+    if (config.headless) {
+        flags = SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE;
+    } else if (config.blitter) {
+        // The blitter only needs somewhere to show its frames
+        flags = config.vsync ? SDL_RENDERER_PRESENTVSYNC : 0u;
+    } else if (config.vsync) {
+        flags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    return sdlCheck(SDL_CreateRenderer(window, -1, flags));
+}
+
 } // namespace
 
 Bitmap::Bitmap()
@@ -22,6 +167,11 @@ Bitmap::Bitmap(SDL_Texture* ptr)
     : _ptr(ptr, SDL_DestroyTexture)
 { }
 
+Bitmap::Bitmap(Image image)
+    : _ptr(nullptr, SDL_DestroyTexture)
+    , _image(std::make_shared<Image>(std::move(image)))
+{ }
+
 Cursor::Cursor()
     : _surface(nullptr, SDL_FreeSurface)
     , _cursor(nullptr, SDL_FreeCursor)
@@ -36,32 +186,100 @@ Cursor::Cursor(SDL_Surface* ptr, int x, int y)
 
 PixelVector Bitmap::size() const
 {
+    if (_image) {
+        return _image->size();
+    }
     auto size = PixelVector{};
     sdlCheck(SDL_QueryTexture(_ptr.get(), nullptr, nullptr, &size.x, &size.y));
     return size;
 }
 
+bool Bitmap::analyzable() const
+{
+    // Loaded blitter images keep their pixels anyway, render targets change
+    return !_coverage.empty() || _indices || (_image && _lifetime);
+}
+
+std::uint8_t Bitmap::coverage(int x, int y, int width) const
+{
+    if (_indices) {
+        auto i = (size_t)y * width + x;
+        return coverageBits((*_palette)[(*_indices)[i]].a);
+    }
+    if (_image) {
+        return coverageBits((std::uint8_t)(_image->row(y)[x] >> 24));
+    }
+    auto i = (size_t)y * width + x;
+    return (_coverage[i / 4] >> (i % 4 * 2)) & (visibleBit | opaqueBit);
+}
+
+PixelRectangle Bitmap::visibleArea(const PixelRectangle& area) const
+{
+    if (!analyzable()) {
+        return area;
+    }
+    auto width = size().x;
+
+    auto left = area.x + area.w;
+    auto top = area.y + area.h;
+    auto right = area.x;
+    auto bottom = area.y;
+    for (int y = area.y; y < area.y + area.h; y++) {
+        for (int x = area.x; x < area.x + area.w; x++) {
+            if (coverage(x, y, width) & visibleBit) {
+                left = std::min(left, x);
+                top = std::min(top, y);
+                right = std::max(right, x + 1);
+                bottom = std::max(bottom, y + 1);
+            }
+        }
+    }
+
+    if (left >= right) {
+        return {area.x, area.y, 0, 0};
+    }
+    return {left, top, right - left, bottom - top};
+}
+
+bool Bitmap::opaque(const PixelRectangle& area) const
+{
+    if (!analyzable() || area.w <= 0 || area.h <= 0) {
+        return false;
+    }
+    auto width = size().x;
+
+    for (int y = area.y; y < area.y + area.h; y++) {
+        for (int x = area.x; x < area.x + area.w; x++) {
+            if (!(coverage(x, y, width) & opaqueBit)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+Palette Bitmap::palette() const
+{
+    return _palette ? *_palette : Palette{};
+}
+
 Font::Font(const std::filesystem::path& path, int ptSize)
 {
     _ptr.reset(sdlCheck(TTF_OpenFont(path.string().c_str(), ptSize)));
 }
 
-Renderer::Renderer()
-    : _window(
-        sdlCheck(SDL_CreateWindow(
-            "gx",
-            SDL_WINDOWPOS_UNDEFINED,
-            SDL_WINDOWPOS_UNDEFINED,
-            1024,
-            768,
-            SDL_WINDOW_RESIZABLE)),
-        SDL_DestroyWindow)
-    , _renderer(
-        sdlCheck(SDL_CreateRenderer(
-            _window.get(),
-            -1,
-            SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC)),
-        SDL_DestroyRenderer)
+Renderer::Renderer(const WindowConfig& config)
+    : _window(createWindow(config), SDL_DestroyWindow)
+    , _renderer(createRenderer(_window.get(), config), SDL_DestroyRenderer)
+    , _blitter(
+        config.blitter ? new Blitter{config.blitterThreads} : nullptr,
+        destroyBlitter)
+    , _textureFormat(nativeTextureFormat(_renderer.get()))
+    , _scaledCache(
+        new ScaledCache{config.blitter ? 0 : config.scaledCacheBytes},
+        destroyScaledCache)
+    , _dirtyRectangles(config.dirtyRectangles)
+    , _capture(nullptr, destroyFrameCapture)
 {
     int x = 0;
     int y = 0;
@@ -71,26 +289,38 @@ Renderer::Renderer()
 
 Bitmap Renderer::loadBitmap(const std::filesystem::path& path) const
 {
-    return Bitmap{
-        sdlCheck(IMG_LoadTexture(_renderer.get(), path.string().c_str()))
-    };
+    GX_TRACE_ZONE("Renderer::loadBitmap");
+    return surfaceBitmap(sdlCheck(IMG_Load(path.string().c_str())));
+}
+
+Bitmap Renderer::recolor(const Bitmap& bitmap, const Palette& palette) const
+{
+    if (!bitmap._indices) {
+        throw Error{"only indexed bitmaps can be recolored"};
+    }
+    return indexedBitmap(bitmap.size(), bitmap._indices, palette);
 }
 
 Bitmap Renderer::loadBitmap(const std::span<const std::byte>& data) const
 {
-    return Bitmap{
-        sdlCheck(IMG_LoadTexture_RW(
-            _renderer.get(),
-            sdlCheck(SDL_RWFromMem(
-                (void*)data.data(),
-                static_cast<int>(data.size()))),
-            1 /* freesrc */))
-    };
+    GX_TRACE_ZONE("Renderer::loadBitmap");
+    return surfaceBitmap(sdlCheck(IMG_Load_RW(
+        sdlCheck(SDL_RWFromMem(
+            (void*)data.data(),
+            static_cast<int>(data.size()))),
+        1 /* freesrc */)));
 }
 
 Cursor Renderer::loadCursor(const std::filesystem::path& path, int x, int y)
 {
-    return Cursor{sdlCheck(IMG_Load(path.string().c_str())), x, y};
+    // Cursors are blended by the system, so their alpha stays straight
+    auto loaded = std::unique_ptr<SDL_Surface, void(*)(SDL_Surface*)>{
+        sdlCheck(IMG_Load(path.string().c_str())), SDL_FreeSurface};
+    return Cursor{
+        sdlCheck(SDL_ConvertSurfaceFormat(
+            loaded.get(), SDL_PIXELFORMAT_ARGB8888, 0)),
+        x,
+        y};
 }
 
 void Renderer::setCursor(Cursor& cursor)
@@ -104,6 +334,7 @@ Bitmap Renderer::prepareText(
     const Color& color,
     int maxLength)
 {
+    GX_TRACE_ZONE("Renderer::prepareText");
     auto sdlColor = SDL_Color{color.r, color.g, color.b, color.a};
 
     SDL_Surface* surface = nullptr;
@@ -118,20 +349,25 @@ Bitmap Renderer::prepareText(
         throw Error{"cannot render text to surface"};
     }
 
-    auto bitmap = Bitmap{sdlCheck(
-        SDL_CreateTextureFromSurface(_renderer.get(), surface))};
-
-    SDL_FreeSurface(surface);
-
-    return bitmap;
+    return surfaceBitmap(surface, false);
 }
 
 void Renderer::draw(
     const Bitmap& bitmap,
     const PixelRectangle& frame,
     const ScreenPoint& position,
-    float zoom)
+    float zoom,
+    bool opaque)
 {
+    if (_blitter) {
+        if (!bitmap._image) {
+            throw Error{"bitmap was not created for the blitter"};
+        }
+        _blitter->draw(bitmap._image, frame, position, zoom, opaque);
+        return;
+    }
+
+    auto* texture = bitmap._ptr.get();
     auto src = SDL_Rect{.x = frame.x, .y = frame.y, .w = frame.w, .h = frame.h};
     auto dst = SDL_FRect{
         .x = position.x - zoom * (float)frame.w / 2.f,
@@ -140,12 +376,33 @@ void Renderer::draw(
         .h = zoom * (float)frame.h
     };
 
-    sdlCheck(SDL_RenderCopyF(_renderer.get(), bitmap._ptr.get(), &src, &dst));
+    if (auto* scaled = _scaledCache->find(
+            _renderer.get(), texture, bitmap._lifetime, frame, zoom)) {
+        texture = scaled;
+        src = {.x = 0, .y = 0, .w = (int)dst.w, .h = (int)dst.h};
+    }
+
+    if (!opaque) {
+        sdlCheck(SDL_RenderCopyF(_renderer.get(), texture, &src, &dst));
+        return;
+    }
+
+    // Blending is a texture setting in SDL, so only this copy goes without
+    auto blendMode = SDL_BLENDMODE_NONE;
+    sdlCheck(SDL_GetTextureBlendMode(texture, &blendMode));
+    sdlCheck(SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE));
+    sdlCheck(SDL_RenderCopyF(_renderer.get(), texture, &src, &dst));
+    sdlCheck(SDL_SetTextureBlendMode(texture, blendMode));
 }
 
 void Renderer::drawRectangle(
     const ScreenRectangle& rectangle, const Color& color)
 {
+    if (_blitter) {
+        _blitter->fill(enclosingPixels(rectangle), packColor(color));
+        return;
+    }
+
     auto rect = SDL_FRect{
         .x = rectangle.x,
         .y = rectangle.y,
@@ -158,6 +415,102 @@ void Renderer::drawRectangle(
     sdlCheck(SDL_RenderFillRectF(_renderer.get(), &rect));
 }
 
+Bitmap Renderer::createTarget(const PixelVector& size) const
+{
+    GX_TRACE_ZONE("Renderer::createTarget");
+    if (_blitter) {
+        return Bitmap{Image{size}};
+    }
+
+    auto bitmap = Bitmap{sdlCheck(SDL_CreateTexture(
+        _renderer.get(),
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_TARGET,
+        size.x,
+        size.y))};
+
+    // Drawing blended sprites into a transparent target leaves premultiplied
+    // colors behind. Not every backend supports custom blend modes, in which
+    // case only semi-transparent edges come out slightly darker.
+    if (SDL_SetTextureBlendMode(
+            bitmap._ptr.get(), premultipliedBlendMode()) < 0) {
+        sdlCheck(SDL_SetTextureBlendMode(
+            bitmap._ptr.get(), SDL_BLENDMODE_BLEND));
+    }
+
+    // Targets are drawn unscaled or scaled up by whole factors, where
+    // nearest filtering keeps pixel edges sharp
+    sdlCheck(SDL_SetTextureScaleMode(
+        bitmap._ptr.get(), SDL_ScaleModeNearest));
+
+    auto previousTarget = SDL_GetRenderTarget(_renderer.get());
+    sdlCheck(SDL_SetRenderTarget(_renderer.get(), bitmap._ptr.get()));
+    sdlCheck(SDL_SetRenderDrawColor(_renderer.get(), 0, 0, 0, 0));
+    sdlCheck(SDL_RenderClear(_renderer.get()));
+    sdlCheck(SDL_SetRenderTarget(_renderer.get(), previousTarget));
+
+    return bitmap;
+}
+
+void Renderer::setTarget(Bitmap* target)
+{
+    if (_blitter) {
+        if (target && !target->_image) {
+            throw Error{"bitmap was not created for the blitter"};
+        }
+        _blitter->setTarget(target ? target->_image : nullptr);
+        return;
+    }
+
+    sdlCheck(SDL_SetRenderTarget(
+        _renderer.get(), target ? target->_ptr.get() : nullptr));
+}
+
+void Renderer::setClip(const std::optional<ScreenRectangle>& clip)
+{
+    _clip = clip;
+    if (_blitter) {
+        _blitter->setClip(
+            clip ? std::optional{enclosingPixels(*clip)} : std::nullopt);
+        return;
+    }
+
+    if (clip) {
+        auto rect = enclosingRect(*clip);
+        sdlCheck(SDL_RenderSetClipRect(_renderer.get(), &rect));
+    } else {
+        sdlCheck(SDL_RenderSetClipRect(_renderer.get(), nullptr));
+    }
+}
+
+const std::optional<ScreenRectangle>& Renderer::clip() const
+{
+    return _clip;
+}
+
+void Renderer::erase(const ScreenRectangle& area)
+{
+    if (_blitter) {
+        _blitter->fill(enclosingPixels(area), 0);
+        return;
+    }
+
+    auto rect = enclosingRect(area);
+    sdlCheck(SDL_SetRenderDrawBlendMode(_renderer.get(), SDL_BLENDMODE_NONE));
+    sdlCheck(SDL_SetRenderDrawColor(_renderer.get(), 0, 0, 0, 0));
+    sdlCheck(SDL_RenderFillRect(_renderer.get(), &rect));
+}
+
+std::pmr::memory_resource* Renderer::frameMemory() const
+{
+    return _frameMemory;
+}
+
+void Renderer::setFrameMemory(std::pmr::memory_resource* memory)
+{
+    _frameMemory = memory;
+}
+
 bool Renderer::processEvent(const SDL_Event& e)
 {
     if (e.type == SDL_WINDOWEVENT &&
@@ -165,21 +518,99 @@ bool Renderer::processEvent(const SDL_Event& e)
         _windowSize = {(float)e.window.data1, (float)e.window.data2};
         return true;
     }
+    if (e.type == SDL_WINDOWEVENT) {
+        switch (e.window.event) {
+            case SDL_WINDOWEVENT_MINIMIZED:
+            case SDL_WINDOWEVENT_HIDDEN:
+                _visible = false;
+                return false;
+            case SDL_WINDOWEVENT_SHOWN:
+            case SDL_WINDOWEVENT_RESTORED:
+            case SDL_WINDOWEVENT_MAXIMIZED:
+                _visible = true;
+                return false;
+            case SDL_WINDOWEVENT_EXPOSED:
+                _visible = true;
+                _exposed = true;
+                return false;
+            default:
+                break;
+        }
+    }
+    // Scaled copies are target textures, whose contents are gone
+    if (e.type == SDL_RENDER_TARGETS_RESET ||
+            e.type == SDL_RENDER_DEVICE_RESET) {
+        _scaledCache->clear();
+    }
 
     return false;
 }
 
 void Renderer::clear()
 {
+    if (_blitter) {
+        _blitter->resize({(int)_windowSize.x, (int)_windowSize.y});
+        _blitter->clear(0xFF000000);
+        return;
+    }
+
     sdlCheck(SDL_SetRenderDrawColor(_renderer.get(), 0, 0, 0, 255));
     sdlCheck(SDL_RenderClear(_renderer.get()));
 }
 
 void Renderer::present()
 {
+    if (_dirtyRectangles) {
+        auto window = PixelRectangle{
+            0, 0, (int)_windowSize.x, (int)_windowSize.y};
+        presentWindowSurface({&window, 1});
+        captureFrame();
+        return;
+    }
+    if (_blitter) {
+        presentFramebuffer();
+    }
+    // The back buffer is undefined after presenting
+    captureFrame();
+
+    GX_TRACE_ZONE("SDL_RenderPresent");
     SDL_RenderPresent(_renderer.get());
 }
 
+void Renderer::present(std::span<const PixelRectangle> areas)
+{
+    if (_dirtyRectangles) {
+        presentWindowSurface(areas);
+        captureFrame();
+    } else {
+        present();
+    }
+}
+
+bool Renderer::dirtyRectangles() const
+{
+    return _dirtyRectangles;
+}
+
+void Renderer::startCapture(const CaptureConfig& config)
+{
+    // Finishes the earlier recording first, so both never write at once
+    _capture.reset();
+    _capture.reset(new FrameCapture{config});
+}
+
+void Renderer::stopCapture()
+{
+    if (_capture) {
+        _capture->stop();
+    }
+}
+
+CaptureStats Renderer::captureStats() const
+{
+    return _capture ? _capture->stats() : CaptureStats{};
+}
+
 const ScreenVector& Renderer::windowSize() const
 {
     return _windowSize;
@@ -190,4 +621,242 @@ ScreenRectangle Renderer::windowArea() const
     return {0, 0, _windowSize.x, _windowSize.y};
 }
 
+bool Renderer::visible() const
+{
+    return _visible;
+}
+
+int Renderer::refreshRate() const
+{
+    auto displayIndex = SDL_GetWindowDisplayIndex(_window.get());
+    auto mode = SDL_DisplayMode{};
+    if (displayIndex < 0 ||
+            SDL_GetCurrentDisplayMode(displayIndex, &mode) != 0) {
+        return 0;
+    }
+    return mode.refresh_rate;
+}
+
+Bitmap Renderer::surfaceBitmap(SDL_Surface* surface, bool analyze) const
+{
+    auto owner = std::unique_ptr<SDL_Surface, void(*)(SDL_Surface*)>{
+        surface, SDL_FreeSurface};
+
+    if (surface->format->format == SDL_PIXELFORMAT_INDEX8) {
+        auto size = PixelVector{surface->w, surface->h};
+        auto indices = std::make_shared<std::vector<std::uint8_t>>(
+            (size_t)size.x * size.y);
+        for (int y = 0; y < size.y; y++) {
+            const auto* row = static_cast<const std::uint8_t*>(
+                surface->pixels) + (ptrdiff_t)y * surface->pitch;
+            std::copy(
+                row, row + size.x, indices->data() + (ptrdiff_t)y * size.x);
+        }
+
+        auto palette = Palette(256);
+        const auto* colors = surface->format->palette;
+        for (int i = 0; i < colors->ncolors && i < 256; i++) {
+            const auto& color = colors->colors[i];
+            palette[i] = {color.r, color.g, color.b, color.a};
+        }
+        auto key = Uint32{};
+        if (SDL_GetColorKey(surface, &key) == 0 && key < palette.size()) {
+            palette[key].a = 0;
+        }
+        return indexedBitmap(size, std::move(indices), std::move(palette));
+    }
+
+    auto coverage = std::vector<std::uint8_t>{};
+    auto bitmap = _blitter ?
+        Bitmap{Image{surface}} :
+        Bitmap{createTexture(surface, analyze ? &coverage : nullptr)};
+    bitmap._lifetime = std::make_shared<char>();
+    bitmap._coverage = std::move(coverage);
+    return bitmap;
+}
+
+SDL_Texture* Renderer::createTexture(
+    SDL_Surface* surface, std::vector<std::uint8_t>* coverage) const
+{
+    GX_TRACE_ZONE("Renderer::createTexture");
+    auto pixels = std::unique_ptr<SDL_Surface, void(*)(SDL_Surface*)>{
+        sdlCheck(SDL_ConvertSurfaceFormat(
+            surface, SDL_PIXELFORMAT_ARGB8888, 0)),
+        SDL_FreeSurface};
+    if (coverage) {
+        *coverage = coverageMask(pixels.get());
+    }
+    auto texture = std::unique_ptr<SDL_Texture, void(*)(SDL_Texture*)>{
+        sdlCheck(SDL_CreateTexture(
+            _renderer.get(),
+            _textureFormat,
+            SDL_TEXTUREACCESS_STATIC,
+            surface->w,
+            surface->h)),
+        SDL_DestroyTexture};
+
+    // Straight alpha where the backend cannot blend premultiplied colors
+    if (SDL_SetTextureBlendMode(
+            texture.get(), premultipliedBlendMode()) == 0) {
+        premultiply(pixels.get());
+    } else {
+        sdlCheck(SDL_SetTextureBlendMode(texture.get(), SDL_BLENDMODE_BLEND));
+    }
+
+    if (_textureFormat != SDL_PIXELFORMAT_ARGB8888) {
+        pixels.reset(sdlCheck(
+            SDL_ConvertSurfaceFormat(pixels.get(), _textureFormat, 0)));
+    }
+    sdlCheck(SDL_UpdateTexture(
+        texture.get(), nullptr, pixels->pixels, pixels->pitch));
+    return texture.release();
+}
+
+Bitmap Renderer::indexedBitmap(
+    const PixelVector& size,
+    std::shared_ptr<const std::vector<std::uint8_t>> indices,
+    Palette palette) const
+{
+    palette.resize(256);
+    auto bitmap = Bitmap{};
+    if (_blitter) {
+        bitmap = Bitmap{Image{size, indices, palette}};
+    } else {
+        auto surface = std::unique_ptr<SDL_Surface, void(*)(SDL_Surface*)>{
+            sdlCheck(SDL_CreateRGBSurfaceWithFormat(
+                0, size.x, size.y, 32, SDL_PIXELFORMAT_ARGB8888)),
+            SDL_FreeSurface};
+        for (int y = 0; y < size.y; y++) {
+            auto* row = reinterpret_cast<std::uint32_t*>(
+                static_cast<std::uint8_t*>(surface->pixels) +
+                (ptrdiff_t)y * surface->pitch);
+            const auto* source = indices->data() + (ptrdiff_t)y * size.x;
+            for (int x = 0; x < size.x; x++) {
+                row[x] = packColor(palette[source[x]]);
+            }
+        }
+        bitmap = Bitmap{createTexture(surface.get(), nullptr)};
+    }
+    bitmap._lifetime = std::make_shared<char>();
+    bitmap._indices = std::move(indices);
+    bitmap._palette = std::make_shared<const Palette>(std::move(palette));
+    return bitmap;
+}
+
+void Renderer::presentFramebuffer()
+{
+    _blitter->flush();
+
+    GX_TRACE_ZONE("SDL_UpdateTexture");
+    const auto& framebuffer = _blitter->framebuffer();
+    auto size = framebuffer.size();
+    if (size.x <= 0 || size.y <= 0) {
+        return;
+    }
+
+    if (!_framebufferTexture._ptr || _framebufferTexture.size() != size) {
+        _framebufferTexture = Bitmap{sdlCheck(SDL_CreateTexture(
+            _renderer.get(),
+            SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_STREAMING,
+            size.x,
+            size.y))};
+        sdlCheck(SDL_SetTextureBlendMode(
+            _framebufferTexture._ptr.get(), SDL_BLENDMODE_NONE));
+    }
+
+    sdlCheck(SDL_UpdateTexture(
+        _framebufferTexture._ptr.get(),
+        nullptr,
+        framebuffer.row(0),
+        size.x * (int)sizeof(std::uint32_t)));
+    sdlCheck(SDL_RenderCopy(
+        _renderer.get(), _framebufferTexture._ptr.get(), nullptr, nullptr));
+}
+
+void Renderer::captureFrame()
+{
+    if (!_capture || !_capture->running()) {
+        return;
+    }
+
+    // The blitter's frame is in system memory already, flushed by presenting
+    if (_blitter) {
+        const auto& framebuffer = _blitter->framebuffer();
+        auto size = framebuffer.size();
+        _capture->capture(size, [&](std::uint32_t* pixels, int) {
+            std::copy_n(framebuffer.row(0), (size_t)size.x * size.y, pixels);
+        });
+        return;
+    }
+
+    auto size = PixelVector{};
+    sdlCheck(SDL_GetRendererOutputSize(_renderer.get(), &size.x, &size.y));
+    _capture->capture(size, [&](std::uint32_t* pixels, int pitch) {
+        GX_TRACE_ZONE("SDL_RenderReadPixels");
+        sdlCheck(SDL_RenderReadPixels(
+            _renderer.get(),
+            nullptr,
+            SDL_PIXELFORMAT_ARGB8888,
+            pixels,
+            pitch));
+    });
+}
+
+void Renderer::presentWindowSurface(std::span<const PixelRectangle> areas)
+{
+    _blitter->flush();
+
+    GX_TRACE_ZONE("SDL_UpdateWindowSurfaceRects");
+    auto* surface = sdlCheck(SDL_GetWindowSurface(_window.get()));
+    auto surfaceSize = PixelVector{surface->w, surface->h};
+    const auto& framebuffer = _blitter->framebuffer();
+    auto bounds = PixelRectangle{
+        0,
+        0,
+        std::min(framebuffer.size().x, surfaceSize.x),
+        std::min(framebuffer.size().y, surfaceSize.y),
+    };
+
+    auto whole = std::array{bounds};
+    if (surface != _windowSurface || surfaceSize != _windowSurfaceSize ||
+            _exposed) {
+        areas = whole;
+        _windowSurface = surface;
+        _windowSurfaceSize = surfaceSize;
+        _exposed = false;
+    }
+
+    auto rects = std::pmr::vector<SDL_Rect>{_frameMemory};
+    if (SDL_MUSTLOCK(surface)) {
+        sdlCheck(SDL_LockSurface(surface));
+    }
+    for (const auto& area : areas) {
+        auto visible = intersection(area, bounds);
+        if (!visible) {
+            continue;
+        }
+        sdlCheck(SDL_ConvertPixels(
+            visible->w,
+            visible->h,
+            SDL_PIXELFORMAT_ARGB8888,
+            framebuffer.row(visible->y) + visible->x,
+            framebuffer.size().x * (int)sizeof(std::uint32_t),
+            surface->format->format,
+            static_cast<std::uint8_t*>(surface->pixels) +
+                (ptrdiff_t)visible->y * surface->pitch +
+                (ptrdiff_t)visible->x * surface->format->BytesPerPixel,
+            surface->pitch));
+        rects.push_back({visible->x, visible->y, visible->w, visible->h});
+    }
+    if (SDL_MUSTLOCK(surface)) {
+        SDL_UnlockSurface(surface);
+    }
+
+    if (!rects.empty()) {
+        sdlCheck(SDL_UpdateWindowSurfaceRects(
+            _window.get(), rects.data(), (int)rects.size()));
+    }
+}
+
 } // namespace gx
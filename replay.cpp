@@ -0,0 +1,126 @@
+#include <gx/replay.hpp>
+
+#include <gx/error.hpp>
+
+#include <array>
+#include <string>
+#include <utility>
+
+namespace gx {
+
+namespace {
+
+constexpr auto magic =
+    std::array<char, 8>{'G', 'X', 'R', 'E', 'P', 'L', 'A', 'Y'};
+constexpr std::uint32_t version = 1;
+
+bool replayable(const SDL_Event& e)
+{
+    switch (e.type) {
+        case SDL_QUIT:
+        case SDL_WINDOWEVENT:
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_TEXTINPUT:
+        case SDL_MOUSEMOTION:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+        case SDL_MOUSEWHEEL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+template <class T>
+void write(std::ofstream& output, const T& value)
+{
+    output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+T read(std::ifstream& input, const std::filesystem::path& path)
+{
+    auto value = T{};
+    if (!input.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+        throw Error{"truncated replay " + path.string()};
+    }
+    return value;
+}
+
+} // namespace
+
+ReplayRecorder::ReplayRecorder(const std::filesystem::path& path)
+    : _output(path, std::ios::binary)
+{
+    if (!_output) {
+        throw Error{"cannot write replay " + path.string()};
+    }
+    _output.write(magic.data(), magic.size());
+    write(_output, version);
+    write(_output, (std::uint32_t)sizeof(SDL_Event));
+}
+
+void ReplayRecorder::event(const SDL_Event& e)
+{
+    if (replayable(e)) {
+        _events.push_back(e);
+    }
+}
+
+void ReplayRecorder::frame(int steps)
+{
+    write(_output, _frame++);
+    write(_output, (std::int32_t)steps);
+    write(_output, (std::uint32_t)_events.size());
+    for (const auto& e : _events) {
+        write(_output, e);
+    }
+    _events.clear();
+}
+
+ReplayPlayer::ReplayPlayer(const std::filesystem::path& path)
+{
+    auto input = std::ifstream{path, std::ios::binary};
+    if (!input) {
+        throw Error{"cannot read replay " + path.string()};
+    }
+
+    auto header = read<std::array<char, 8>>(input, path);
+    auto fileVersion = read<std::uint32_t>(input, path);
+    auto eventSize = read<std::uint32_t>(input, path);
+    if (header != magic || fileVersion != version ||
+            eventSize != sizeof(SDL_Event)) {
+        throw Error{"incompatible replay " + path.string()};
+    }
+
+    while (input.peek() != std::ifstream::traits_type::eof()) {
+        auto& frame = _frames.emplace_back();
+        frame.index = read<std::uint64_t>(input, path);
+        frame.steps = read<std::int32_t>(input, path);
+        frame.events.resize(read<std::uint32_t>(input, path));
+        for (auto& e : frame.events) {
+            e = read<SDL_Event>(input, path);
+        }
+    }
+}
+
+ReplayPlayer::ReplayPlayer(std::vector<ReplayFrame> frames)
+    : _frames(std::move(frames))
+{ }
+
+bool ReplayPlayer::next()
+{
+    if (_next >= _frames.size()) {
+        return false;
+    }
+    _next++;
+    return true;
+}
+
+const ReplayFrame& ReplayPlayer::frame() const
+{
+    return _frames.at(_next - 1);
+}
+
+} // namespace gx
@@ -0,0 +1,143 @@
+#include <gx/scaled_cache.hpp>
+
+#include <gx/error.hpp>
+#include <gx/trace.hpp>
+
+#include <cmath>
+#include <functional>
+
+namespace gx {
+
+namespace {
+
+size_t combine(size_t seed, size_t value)
+{
+    return seed ^ (value + 0x9E3779B9 + (seed << 6) + (seed >> 2));
+}
+
+// Copies the frame into a new target texture without blending, or returns
+// nullptr if SDL cannot create one that large. The renderer's target and
+// clip rectangle are left as they were.
+SDL_Texture* scaleFrame(
+    SDL_Renderer* renderer,
+    SDL_Texture* texture,
+    const PixelRectangle& frame,
+    int zoom)
+{
+    GX_TRACE_ZONE("ScaledCache::scaleFrame");
+    auto* scaled = SDL_CreateTexture(
+        renderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_TARGET,
+        frame.w * zoom,
+        frame.h * zoom);
+    if (!scaled) {
+        return nullptr;
+    }
+
+    auto blendMode = SDL_BLENDMODE_NONE;
+    sdlCheck(SDL_GetTextureBlendMode(texture, &blendMode));
+    sdlCheck(SDL_SetTextureBlendMode(scaled, blendMode));
+
+    auto previousTarget = SDL_GetRenderTarget(renderer);
+    auto clip = SDL_Rect{};
+    SDL_RenderGetClipRect(renderer, &clip);
+    bool clipped = SDL_RenderIsClipEnabled(renderer);
+
+    auto src = SDL_Rect{.x = frame.x, .y = frame.y, .w = frame.w, .h = frame.h};
+    sdlCheck(SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE));
+    sdlCheck(SDL_SetRenderTarget(renderer, scaled));
+    sdlCheck(SDL_RenderCopy(renderer, texture, &src, nullptr));
+    sdlCheck(SDL_SetRenderTarget(renderer, previousTarget));
+    sdlCheck(SDL_SetTextureBlendMode(texture, blendMode));
+    sdlCheck(SDL_RenderSetClipRect(renderer, clipped ? &clip : nullptr));
+
+    return scaled;
+}
+
+} // namespace
+
+size_t ScaledCache::KeyHash::operator()(const Key& key) const
+{
+    auto hash = std::hash<const void*>{}(key.texture);
+    for (auto value : {key.frame.x, key.frame.y, key.frame.w, key.frame.h,
+            key.zoom}) {
+        hash = combine(hash, std::hash<int>{}(value));
+    }
+    return hash;
+}
+
+ScaledCache::ScaledCache(size_t capacity)
+    : _capacity(capacity)
+{ }
+
+SDL_Texture* ScaledCache::find(
+    SDL_Renderer* renderer,
+    SDL_Texture* texture,
+    const std::shared_ptr<const void>& owner,
+    const PixelRectangle& frame,
+    float zoom)
+{
+    auto factor = (int)zoom;
+    if (factor < 2 || (float)factor != zoom || frame.w <= 0 ||
+            frame.h <= 0 || !owner) {
+        return nullptr;
+    }
+    auto bytes = (size_t)frame.w * frame.h * factor * factor * 4;
+    if (bytes > _capacity) {
+        return nullptr;
+    }
+
+    auto key = Key{.texture = texture, .frame = frame, .zoom = factor};
+    if (auto found = _index.find(key); found != _index.end()) {
+        auto entry = found->second;
+        if (entry->owner.lock() == owner) {
+            _entries.splice(_entries.begin(), _entries, entry);
+            return entry->texture.get();
+        }
+        // Left behind by a destroyed texture at the same address
+        erase(entry);
+    }
+
+    if (!SDL_RenderTargetSupported(renderer)) {
+        return nullptr;
+    }
+    while (_size + bytes > _capacity) {
+        erase(std::prev(_entries.end()));
+    }
+
+    auto* scaled = scaleFrame(renderer, texture, frame, factor);
+    if (!scaled) {
+        return nullptr;
+    }
+    _entries.push_front(Entry{
+        .key = key,
+        .owner = owner,
+        .texture = {scaled, SDL_DestroyTexture},
+        .bytes = bytes,
+    });
+    _index.emplace(key, _entries.begin());
+    _size += bytes;
+    return scaled;
+}
+
+void ScaledCache::clear()
+{
+    _entries.clear();
+    _index.clear();
+    _size = 0;
+}
+
+size_t ScaledCache::size() const
+{
+    return _size;
+}
+
+void ScaledCache::erase(std::list<Entry>::iterator entry)
+{
+    _size -= entry->bytes;
+    _index.erase(entry->key);
+    _entries.erase(entry);
+}
+
+} // namespace gx
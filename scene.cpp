@@ -1,5 +1,8 @@
 #include <gx/scene.hpp>
 
+#include <gx/trace.hpp>
+
+#include <algorithm>
 #include <cmath>
 #include <utility>
 
@@ -47,6 +50,7 @@ Camera& Scene::camera()
 
 void Scene::update(float delta)
 {
+    GX_TRACE_ZONE("Scene::update");
     _camera.update(delta);
 
     for (size_t i = 0; i < _objects.size(); ) {
@@ -58,18 +62,274 @@ void Scene::update(float delta)
             i++;
         }
     }
+
+    if (_snapshots) {
+        publish();
+    }
 }
 
-void Scene::render(Renderer& renderer, const ScreenRectangle& area) const
+template <class F>
+void Scene::forEachSprite(const SceneSnapshot* snapshot, F&& f) const
 {
+    if (snapshot) {
+        for (const auto& sprite : snapshot->sprites) {
+            f(*sprite.frame, sprite.position);
+        }
+        return;
+    }
+
     for (const auto& object : _objects) {
-        auto objectOffset = _camera.worldPointToScreenOffset(object->position);
-        auto objectPosition = area.middlePoint() + objectOffset;
+        f(object->animation.spriteFrame(), object->position);
+    }
+}
+
+void Scene::render(Renderer& renderer) const
+{
+    GX_TRACE_ZONE("Scene::render");
+
+    // Read the snapshot once, a second read may already return a newer one
+    const auto* snapshot = _frameSnapshot ? _frameSnapshot :
+        _snapshots ? &_snapshots->read() : nullptr;
+    const auto& camera = snapshot ? snapshot->camera : _camera;
+
+    if (auto scale = lowResolutionScale(camera)) {
+        renderLowResolution(renderer, camera, scale, snapshot);
+        return;
+    }
+
+    auto middle = _area.middlePoint();
+    forEachSprite(snapshot, [&] (
+            const SpriteFrame& frame, const WorldPoint& position) {
+        drawFrame(
+            renderer,
+            frame,
+            middle + camera.worldPointToScreenOffset(position),
+            camera.zoom);
+    });
+}
+
+Scene::LowResolutionLayout Scene::lowResolutionLayout(
+    const Camera& camera, int scale) const
+{
+    // One spare art pixel on each side covers the sub-pixel camera offset
+    auto size = PixelVector{
+        (int)std::ceil(_area.w / (float)scale) + 2,
+        (int)std::ceil(_area.h / (float)scale) + 2,
+    };
+
+    // Camera position in art pixels, with y pointing down as on screen. The
+    // whole part places sprites in the target, the fraction is applied when
+    // the target is scaled up.
+    auto cameraX = camera.position.x * camera.unitPixelSize;
+    auto cameraY = -camera.position.y * camera.unitPixelSize;
+    auto snappedX = std::floor(cameraX);
+    auto snappedY = std::floor(cameraY);
+    auto center = PixelPoint{size.x / 2, size.y / 2};
+
+    // Put the exact camera position, not the snapped one, in the middle
+    auto middle = _area.middlePoint();
+    return {
+        .size = size,
+        .scale = scale,
+        .origin = {
+            snappedX - (float)center.x,
+            snappedY - (float)center.y,
+        },
+        .screenOrigin = {
+            middle.x - ((float)center.x + cameraX - snappedX) * (float)scale,
+            middle.y - ((float)center.y + cameraY - snappedY) * (float)scale,
+        },
+    };
+}
+
+ScreenRectangle Scene::LowResolutionLayout::frameArea(
+    const SpriteFrame& frame,
+    const WorldPoint& position,
+    const Camera& camera) const
+{
+    // Snap the top left corner in world space, so that sprites keep their
+    // relative placement while the camera moves
+    auto offset = frame.offset();
+    auto left = std::round(position.x * camera.unitPixelSize + offset.x -
+        (float)frame.frame.w / 2.f - origin.x);
+    auto top = std::round(-position.y * camera.unitPixelSize + offset.y -
+        (float)frame.frame.h / 2.f - origin.y);
+    return {left, top, (float)frame.frame.w, (float)frame.frame.h};
+}
+
+ScreenRectangle Scene::LowResolutionLayout::screenArea(
+    const ScreenRectangle& area) const
+{
+    return {
+        screenOrigin.x + area.x * (float)scale,
+        screenOrigin.y + area.y * (float)scale,
+        area.w * (float)scale,
+        area.h * (float)scale,
+    };
+}
+
+void Scene::renderLowResolution(
+    Renderer& renderer,
+    const Camera& camera,
+    int scale,
+    const SceneSnapshot* snapshot) const
+{
+    if (_area.w <= 0 || _area.h <= 0) {
+        return;
+    }
+
+    auto layout = lowResolutionLayout(camera, scale);
+    if (layout.size != _lowResolutionSize) {
+        _lowResolutionSize = layout.size;
+        _lowResolutionTarget = renderer.createTarget(layout.size);
+    }
+
+    // The clip rectangle is in screen space, such as a dirty rectangle
+    // that Box is redrawing, so it only applies to scaling up the target
+    auto clip = renderer.clip();
+    renderer.setClip(std::nullopt);
+    renderer.setTarget(&_lowResolutionTarget);
+    renderer.erase({0, 0, (float)layout.size.x, (float)layout.size.y});
+    forEachSprite(snapshot, [&] (
+            const SpriteFrame& frame, const WorldPoint& position) {
         renderer.draw(
-            object->animation.bitmap(),
-            object->animation.frame(),
-            objectPosition,
-            (float)_camera.zoom);
+            *frame.bitmap,
+            frame.frame,
+            layout.frameArea(frame, position, camera).middlePoint(),
+            1.f,
+            frame.opaque);
+    });
+    renderer.setTarget(nullptr);
+
+    auto target = layout.screenArea(
+        {0, 0, (float)layout.size.x, (float)layout.size.y});
+    if (auto visible = clip ? intersection(*clip, _area) : _area) {
+        renderer.setClip(visible);
+        renderer.draw(
+            _lowResolutionTarget,
+            {0, 0, layout.size.x, layout.size.y},
+            target.middlePoint(),
+            (float)scale);
+    }
+    renderer.setClip(clip);
+}
+
+int Scene::lowResolutionScale(const Camera& camera) const
+{
+    auto scale = std::round(camera.zoom);
+    if (_lowResolution && scale >= 1.f && scale == camera.zoom) {
+        return (int)scale;
+    }
+    return 0;
+}
+
+void Scene::damage(Damage& damage)
+{
+    GX_TRACE_ZONE("Scene::damage");
+    _frameSnapshot = _snapshots ? &_snapshots->read() : nullptr;
+    const auto& camera = _frameSnapshot ? _frameSnapshot->camera : _camera;
+
+    // In low resolution, sprites land on whole art pixels of the target,
+    // which is scaled up with the same offset as long as the camera stays
+    auto scale = lowResolutionScale(camera);
+    _spritesToDraw.clear();
+    if (scale) {
+        auto layout = lowResolutionLayout(camera, scale);
+        forEachSprite(_frameSnapshot, [&] (
+                const SpriteFrame& frame, const WorldPoint& position) {
+            _spritesToDraw.push_back(DrawnSprite{
+                .frame = &frame,
+                .area = layout.screenArea(
+                    layout.frameArea(frame, position, camera)),
+            });
+        });
+    } else {
+        auto middle = _area.middlePoint();
+        forEachSprite(_frameSnapshot, [&] (
+                const SpriteFrame& frame, const WorldPoint& position) {
+            _spritesToDraw.push_back(DrawnSprite{
+                .frame = &frame,
+                .area = frameArea(
+                    frame,
+                    middle + camera.worldPointToScreenOffset(position),
+                    camera.zoom),
+            });
+        });
+    }
+
+    // Renderers round sprites to whole pixels, which can move an edge by
+    // one pixel
+    auto add = [&damage] (const DrawnSprite& sprite) {
+        const auto& area = sprite.area;
+        damage.add({area.x - 1.f, area.y - 1.f, area.w + 2.f, area.h + 2.f});
+    };
+
+    // Sprites that went out of the scene's area were still drawn, and the
+    // camera also decides where the low resolution target is scaled up to
+    bool whole = !_drawnCamera || _drawnArea != _area ||
+        _drawnScale != scale ||
+        _drawnCamera->position != camera.position ||
+        _drawnCamera->unitPixelSize != camera.unitPixelSize ||
+        _drawnCamera->zoom != camera.zoom;
+    if (whole) {
+        damage.add(_area);
+        std::ranges::for_each(_drawnSprites, add);
+        std::ranges::for_each(_spritesToDraw, add);
+    } else {
+        // Comparing in drawing order also catches sprites that kept their
+        // place on screen but now stack differently
+        auto count = std::max(_drawnSprites.size(), _spritesToDraw.size());
+        for (size_t i = 0; i < count; i++) {
+            bool drawn = i < _drawnSprites.size();
+            bool toDraw = i < _spritesToDraw.size();
+            if (drawn && toDraw && _drawnSprites[i] == _spritesToDraw[i]) {
+                continue;
+            }
+            if (drawn) {
+                add(_drawnSprites[i]);
+            }
+            if (toDraw) {
+                add(_spritesToDraw[i]);
+            }
+        }
+    }
+
+    std::swap(_drawnSprites, _spritesToDraw);
+    _drawnCamera = camera;
+    _drawnArea = _area;
+    _drawnScale = scale;
+}
+
+std::optional<float> Scene::nextChange() const
+{
+    auto next = std::optional<float>{};
+    for (const auto& object : _objects) {
+        if (auto change = object->animation.timeToNextFrame()) {
+            next = std::min(next.value_or(*change), *change);
+        }
+    }
+    return next;
+}
+
+bool Scene::retained() const
+{
+    return false;
+}
+
+bool Scene::simulated() const
+{
+    return true;
+}
+
+void Scene::pipeline(bool enabled)
+{
+    // Snapshots come from new buffers, or stop coming
+    _frameSnapshot = nullptr;
+    if (enabled) {
+        _snapshots = std::make_unique<TripleBuffer<SceneSnapshot>>();
+        publish();
+    } else {
+        _snapshots.reset();
     }
 }
 
@@ -86,6 +346,15 @@ void Scene::cameraFollow(Object* object)
     _camera.follow = object;
 }
 
+void Scene::lowResolution(bool enabled)
+{
+    _lowResolution = enabled;
+    if (!enabled) {
+        _lowResolutionTarget = {};
+        _lowResolutionSize = {};
+    }
+}
+
 Object* Scene::spawn(const Sprite& sprite, const WorldPoint& position)
 {
     auto* ptr = new Object{
@@ -95,23 +364,112 @@ Object* Scene::spawn(const Sprite& sprite, const WorldPoint& position)
     return _objects.emplace_back(ptr).get();
 }
 
+void Scene::apply(const SceneCommand& command)
+{
+    using Type = SceneCommand::Type;
+
+    if (command.type == Type::Spawn) {
+        // A second object under the same key could never be moved or killed
+        if (_keyedObjects.contains(command.key)) {
+            _rejectedSpawns++;
+            return;
+        }
+        _keyedObjects[command.key] =
+            spawn(*command.sprite, command.position);
+        return;
+    }
+
+    if (command.type == Type::MoveCamera) {
+        _camera.follow = nullptr;
+        _camera.position = command.position;
+        return;
+    }
+
+    auto it = _keyedObjects.find(command.key);
+    if (it == _keyedObjects.end()) {
+        return;
+    }
+    auto* object = it->second;
+
+    switch (command.type) {
+        case Type::Move:
+            object->position = command.position;
+            break;
+        case Type::Kill:
+            object->kill = true;
+            if (_camera.follow == object) {
+                _camera.follow = nullptr;
+            }
+            _keyedObjects.erase(it);
+            break;
+        case Type::FollowWithCamera:
+            _camera.follow = object;
+            break;
+        default:
+            break;
+    }
+}
+
+size_t Scene::rejectedSpawns() const
+{
+    return _rejectedSpawns;
+}
+
+size_t Scene::apply(SceneCommandQueue& queue)
+{
+    GX_TRACE_ZONE("Scene::apply");
+    return queue.consume([this] (const SceneCommand& command) {
+        apply(command);
+    });
+}
+
 void Scene::clickAction(std::function<void(const WorldPoint&)> action)
 {
     _clickAction = std::move(action);
 }
 
-Widget* Scene::locate(const ScreenRectangle& area, const ScreenPoint& point)
+std::optional<ScreenRectangle> Scene::hitArea() const
+{
+    return _area;
+}
+
+void Scene::onLayout(const ScreenRectangle& area)
 {
-    return area.contains(point) ? this : nullptr;
+    _area = area;
 }
 
 void Scene::onPress(const ScreenRectangle& area, const ScreenPoint& point)
 {
     if (_clickAction) {
         auto screenOffset = point - area.middlePoint();
-        auto worldPoint = _camera.screenOffsetToWorldPoint(screenOffset);
+        auto worldPoint =
+            visibleCamera().screenOffsetToWorldPoint(screenOffset);
         _clickAction(worldPoint);
     }
 }
 
+void Scene::publish()
+{
+    GX_TRACE_ZONE("Scene::publish");
+    auto& snapshot = _snapshots->back();
+
+    snapshot.camera = _camera;
+    snapshot.camera.follow = nullptr;
+
+    snapshot.sprites.clear();
+    for (const auto& object : _objects) {
+        snapshot.sprites.push_back(SceneSnapshot::Sprite{
+            .frame = &object->animation.spriteFrame(),
+            .position = object->position,
+        });
+    }
+
+    _snapshots->publish();
+}
+
+const Camera& Scene::visibleCamera() const
+{
+    return _snapshots ? _snapshots->read().camera : _camera;
+}
+
 } // namespace gx
@@ -9,6 +9,50 @@
 
 namespace gx {
 
+ScreenVector SpriteFrame::offset() const
+{
+    return {
+        (float)trim.x + (float)(frame.w - size.x) / 2.f,
+        (float)trim.y + (float)(frame.h - size.y) / 2.f,
+    };
+}
+
+SpriteFrame analyzeFrame(
+    const Bitmap& bitmap, const PixelRectangle& frame, float duration)
+{
+    auto visible = bitmap.visibleArea(frame);
+    return SpriteFrame{
+        .bitmap = &bitmap,
+        .frame = visible,
+        .duration = duration,
+        .size = {frame.w, frame.h},
+        .trim = {visible.x - frame.x, visible.y - frame.y},
+        .opaque = bitmap.opaque(visible),
+    };
+}
+
+ScreenRectangle frameArea(
+    const SpriteFrame& frame, const ScreenPoint& position, float zoom)
+{
+    return ScreenRectangle::atPosition(
+        position + frame.offset() * zoom,
+        ScreenVector{(float)frame.frame.w, (float)frame.frame.h} * zoom);
+}
+
+void drawFrame(
+    Renderer& renderer,
+    const SpriteFrame& frame,
+    const ScreenPoint& position,
+    float zoom)
+{
+    renderer.draw(
+        *frame.bitmap,
+        frame.frame,
+        position + frame.offset() * zoom,
+        zoom,
+        frame.opaque);
+}
+
 Sprite createSimpleSprite(const Bitmap& bitmap, int frameCount, float fps)
 {
     auto size = bitmap.size();
@@ -22,16 +66,13 @@ Sprite createSimpleSprite(const Bitmap& bitmap, int frameCount, float fps)
 
     auto sprite = Sprite{};
     for (int i = 0; i < frameCount; i++) {
-        sprite.frames.push_back(SpriteFrame{
-            .bitmap = &bitmap,
-            .frame = PixelRectangle{
-                .x = i * spriteWidth,
-                .y = 0,
-                .w = spriteWidth,
-                .h = size.y
-            },
-            .duration = 1.f / fps,
-        });
+        auto frame = PixelRectangle{
+            .x = i * spriteWidth,
+            .y = 0,
+            .w = spriteWidth,
+            .h = size.y
+        };
+        sprite.frames.push_back(analyzeFrame(bitmap, frame, 1.f / fps));
     }
 
     return sprite;
@@ -47,11 +88,7 @@ Sprite createOneFrameSprite(
     fittedFrame.h = std::min(fittedFrame.h, bitmap.size().y);
 
     auto sprite = Sprite{.zoom = zoom};
-    sprite.frames.push_back(SpriteFrame{
-        .bitmap = &bitmap,
-        .frame = fittedFrame,
-        .duration = 1.f
-    });
+    sprite.frames.push_back(analyzeFrame(bitmap, fittedFrame, 1.f));
 
     return sprite;
 }
@@ -67,33 +104,48 @@ Animation::Animation(const Sprite& sprite)
     }
 }
 
+const SpriteFrame& Animation::spriteFrame() const
+{
+    return _sprite->frames.at(_frameIndex);
+}
+
 const Bitmap& Animation::bitmap() const
 {
-    return *_sprite->frames.at(_frameIndex).bitmap;
+    return *spriteFrame().bitmap;
 }
 
 const PixelRectangle& Animation::frame() const
 {
-    return _sprite->frames.at(_frameIndex).frame;
+    return spriteFrame().frame;
 }
 
 ScreenVector Animation::size() const
 {
-    const auto& f = frame();
-    return {(float)f.w * _sprite->zoom, (float)f.h * _sprite->zoom};
+    const auto& size = spriteFrame().size;
+    return {(float)size.x * _sprite->zoom, (float)size.y * _sprite->zoom};
 }
 
-void Animation::update(float delta)
+bool Animation::update(float delta)
 {
+    auto previousFrameIndex = _frameIndex;
     float totalDuration = _durationSum.back();
     _time = std::fmod(_time + delta, totalDuration);
     _frameIndex =
         std::ranges::upper_bound(_durationSum, _time) - _durationSum.begin();
+    return _frameIndex != previousFrameIndex;
+}
+
+std::optional<float> Animation::timeToNextFrame() const
+{
+    if (!_sprite || _sprite->frames.size() < 2) {
+        return std::nullopt;
+    }
+    return std::max(_durationSum.at(_frameIndex) - _time, 0.f);
 }
 
 void Animation::draw(Renderer& renderer, const ScreenPoint& position) const
 {
-    renderer.draw(bitmap(), frame(), position, _sprite->zoom);
+    drawFrame(renderer, spriteFrame(), position, _sprite->zoom);
 }
 
 void Animation::noloop()
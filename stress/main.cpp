@@ -0,0 +1,610 @@
+#include <gx.hpp>
+
+#include "build-info.hpp"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Usage: gx-stress [--objects N] [--frames N] [--replay FILE]
+//                  [--record FILE] [--thresholds FILE] [--baseline FILE]
+//                  [--size WIDTHxHEIGHT] [--blitter THREADS]
+//                  [--present full|dirty] [--capture PATH]
+//
+// Runs a scene with many objects, bullets and UI from a recorded session,
+// headless and as fast as possible, and fails if the measured frame times
+// or counters cross the thresholds. Without --replay, a scripted session is
+// played. --record opens a window and records a session instead.
+// --blitter draws with gx's software blitter on that many threads (0 for
+// one per core), to measure how tile rasterization scales. --present dirty
+// redraws and presents only dirty rectangles, which needs --blitter.
+// --capture records the presented frames, as a Y4M stream if the path ends
+// in .y4m and as PNG files in that directory otherwise, and reports what
+// that cost the frame loop. --baseline writes thresholds derived from this
+// run to the file instead of checking any; run it on the reference
+// machine to set the limits in stress/thresholds.txt. Thresholds are only
+// checked by runs with the configuration they were measured with.
+
+namespace {
+
+struct Options {
+    size_t objects = 2000;
+    size_t frames = 1200;
+    std::filesystem::path replay;
+    std::filesystem::path record;
+    std::filesystem::path thresholds =
+        gx::SOURCE_ROOT / "stress" / "thresholds.txt";
+    std::filesystem::path baseline;
+    gx::PixelVector size {1024, 768};
+    std::optional<int> blitterThreads;
+    bool dirtyRectangles = false;
+    std::filesystem::path capture;
+};
+
+Options parseOptions(int argc, char* argv[])
+{
+    auto options = Options{};
+    for (int i = 1; i < argc; i++) {
+        auto arg = std::string_view{argv[i]};
+        if (i + 1 >= argc) {
+            throw gx::Error{"missing value for " + std::string{arg}};
+        }
+        auto value = std::string{argv[++i]};
+        if (arg == "--objects") {
+            options.objects = std::stoul(value);
+        } else if (arg == "--frames") {
+            options.frames = std::stoul(value);
+        } else if (arg == "--replay") {
+            options.replay = value;
+        } else if (arg == "--record") {
+            options.record = value;
+        } else if (arg == "--thresholds") {
+            options.thresholds = value;
+        } else if (arg == "--baseline") {
+            options.baseline = value;
+        } else if (arg == "--size") {
+            auto separator = value.find('x');
+            if (separator == std::string::npos) {
+                throw gx::Error{"size must look like 1920x1080"};
+            }
+            options.size = {
+                std::stoi(value.substr(0, separator)),
+                std::stoi(value.substr(separator + 1)),
+            };
+        } else if (arg == "--blitter") {
+            options.blitterThreads = std::stoi(value);
+        } else if (arg == "--present") {
+            if (value != "full" && value != "dirty") {
+                throw gx::Error{"present must be full or dirty"};
+            }
+            options.dirtyRectangles = value == "dirty";
+        } else if (arg == "--capture") {
+            options.capture = value;
+        } else {
+            throw gx::Error{"unknown option " + std::string{arg}};
+        }
+    }
+    return options;
+}
+
+SDL_Event keyEvent(Uint32 type, int key)
+{
+    auto e = SDL_Event{};
+    e.type = type;
+    e.key.keysym.sym = key;
+    return e;
+}
+
+SDL_Event mouseEvent(Uint32 type, int x, int y)
+{
+    auto e = SDL_Event{};
+    e.type = type;
+    if (type == SDL_MOUSEMOTION) {
+        e.motion.x = x;
+        e.motion.y = y;
+    } else {
+        e.button.button = SDL_BUTTON_LEFT;
+        e.button.x = x;
+        e.button.y = y;
+    }
+    return e;
+}
+
+// Walks the hero around a square while circling the mouse around it and
+// firing every few frames
+std::vector<gx::ReplayFrame> scriptedSession(
+    size_t frameCount, const gx::ScreenVector& windowSize)
+{
+    static constexpr auto keys = std::array{SDLK_d, SDLK_w, SDLK_a, SDLK_s};
+    static constexpr size_t framesPerKey = 120;
+
+    auto frames = std::vector<gx::ReplayFrame>{};
+    for (size_t i = 0; i < frameCount; i++) {
+        auto& frame = frames.emplace_back();
+        frame.index = i;
+        frame.steps = 1;
+
+        if (i % framesPerKey == 0) {
+            auto key = (i / framesPerKey) % keys.size();
+            if (i > 0) {
+                frame.events.push_back(keyEvent(
+                    SDL_KEYUP, keys.at((key + keys.size() - 1) % keys.size())));
+            }
+            frame.events.push_back(keyEvent(SDL_KEYDOWN, keys.at(key)));
+        }
+
+        auto angle = (float)i * 0.05f;
+        auto x = (int)(windowSize.x / 2 + 200 * std::cos(angle));
+        auto y = (int)(windowSize.y / 2 + 200 * std::sin(angle));
+        frame.events.push_back(mouseEvent(SDL_MOUSEMOTION, x, y));
+        if (i % 4 == 0) {
+            frame.events.push_back(mouseEvent(SDL_MOUSEBUTTONDOWN, x, y));
+        } else if (i % 4 == 1) {
+            frame.events.push_back(mouseEvent(SDL_MOUSEBUTTONUP, x, y));
+        }
+    }
+    return frames;
+}
+
+struct Resources {
+    gx::Bitmap tree;
+    gx::Bitmap hero;
+    gx::Bitmap bullet;
+    gx::Bitmap button;
+    gx::Bitmap pressAnimation;
+    gx::Bitmap label;
+    gx::Font font;
+
+    gx::Sprite treeSprite;
+    gx::Sprite heroSprite;
+    gx::Sprite bulletSprite;
+    gx::Sprite buttonSprite;
+    gx::Sprite pressAnimationSprite;
+    gx::Sprite labelSprite;
+};
+
+void loadResources(gx::Box& box, Resources& r)
+{
+    const auto root = gx::SOURCE_ROOT / "example";
+
+    r.tree = box.loadBitmap(root / "tree.png");
+    r.treeSprite = gx::createSimpleSprite(r.tree, 2, 3);
+    r.hero = box.loadBitmap(root / "hero.png");
+    r.heroSprite = gx::createSimpleSprite(r.hero);
+    r.bullet = box.loadBitmap(root / "bullet.png");
+    r.bulletSprite = gx::createSimpleSprite(r.bullet);
+    r.button = box.loadBitmap(root / "button.png");
+    r.buttonSprite =
+        gx::createOneFrameSprite(r.button, {0, 0, 64, 16}, 2);
+    r.pressAnimation = box.loadBitmap(root / "press-animation.png");
+    r.pressAnimationSprite =
+        gx::createSimpleSprite(r.pressAnimation, 7, 14);
+
+    r.font = gx::Font{root / "nasalization-rg.otf", 14};
+    r.label = box.renderer().prepareText(r.font, "Stress", {0, 0, 0, 255});
+    r.labelSprite = gx::createSimpleSprite(r.label);
+}
+
+struct Bullet {
+    std::uint64_t key = 0;
+    gx::WorldPoint position;
+    gx::WorldVector velocity;
+    float age = 0.f;
+};
+
+// Deterministic game side: everything it does depends on input and steps
+struct Simulation {
+    void processEvent(const SDL_Event& e)
+    {
+        if (e.type != SDL_KEYDOWN && e.type != SDL_KEYUP) {
+            return;
+        }
+        bool press = e.type == SDL_KEYDOWN;
+        switch (e.key.keysym.sym) {
+            case SDLK_a: left = press; break;
+            case SDLK_d: right = press; break;
+            case SDLK_w: up = press; break;
+            case SDLK_s: down = press; break;
+            default: break;
+        }
+    }
+
+    void shoot(const gx::WorldPoint& target)
+    {
+        static constexpr float bulletSpeed = 10.f;
+
+        auto velocity = (target - hero).resized(bulletSpeed);
+        auto bullet = Bullet{
+            .key = nextKey++,
+            .position = hero,
+            .velocity = velocity,
+        };
+        bullets.push_back(bullet);
+        pending.push_back(gx::SceneCommand{
+            .type = gx::SceneCommand::Type::Spawn,
+            .key = bullet.key,
+            .sprite = bulletSprite,
+            .position = bullet.position,
+        });
+        bulletsSpawned++;
+    }
+
+    void step(float delta)
+    {
+        static constexpr float speed = 4.f;
+
+        auto direction = gx::WorldVector{
+            (float)right - (float)left, (float)up - (float)down};
+        hero += direction.normalized() * speed * delta;
+
+        for (size_t i = 0; i < bullets.size(); ) {
+            auto& bullet = bullets.at(i);
+            bullet.position += bullet.velocity * delta;
+            bullet.age += delta;
+            if (bullet.age > 1.f) {
+                pending.push_back(gx::SceneCommand{
+                    .type = gx::SceneCommand::Type::Kill,
+                    .key = bullet.key,
+                });
+                std::swap(bullet, bullets.back());
+                bullets.pop_back();
+            } else {
+                pending.push_back(gx::SceneCommand{
+                    .type = gx::SceneCommand::Type::Move,
+                    .key = bullet.key,
+                    .position = bullet.position,
+                });
+                i++;
+            }
+        }
+
+        auto published = commands.pushBatches(std::span{pending});
+        pending.erase(
+            pending.begin(), pending.begin() + (std::ptrdiff_t)published);
+    }
+
+    gx::SceneCommandQueue commands {8192};
+    std::vector<gx::SceneCommand> pending;
+    const gx::Sprite* bulletSprite = nullptr;
+    gx::WorldPoint hero;
+    bool left = false;
+    bool right = false;
+    bool up = false;
+    bool down = false;
+    std::vector<Bullet> bullets;
+    std::uint64_t nextKey = 1;
+    size_t bulletsSpawned = 0;
+};
+
+using Report = std::map<std::string, double>;
+
+double percentile(const std::vector<double>& sorted, double fraction)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    auto index = (size_t)std::ceil(fraction * (double)sorted.size()) - 1;
+    return sorted.at(std::min(index, sorted.size() - 1));
+}
+
+std::string describeConfiguration(const Options& options)
+{
+    return std::to_string(options.objects) + " objects, " +
+        std::to_string(options.frames) + " frames, " +
+        std::to_string(options.size.x) + "x" +
+        std::to_string(options.size.y) + ", " +
+        (options.replay.empty() ? "scripted session" :
+            "replay " + options.replay.filename().string()) + ", " +
+        (options.blitterThreads ?
+            "blitter on " + std::to_string(*options.blitterThreads) +
+                " threads" :
+            std::string{"SDL software renderer"}) + ", " +
+        (options.dirtyRectangles ? "dirty" : "full") + " presents";
+}
+
+constexpr auto configurationPrefix =
+    std::string_view{"# Baseline configuration: "};
+
+// The configuration a thresholds file was measured with, empty if it does
+// not say
+std::string baselineConfiguration(const std::filesystem::path& path)
+{
+    auto input = std::ifstream{path};
+    if (!input) {
+        throw gx::Error{"cannot read thresholds " + path.string()};
+    }
+    for (std::string line; std::getline(input, line); ) {
+        if (line.starts_with(configurationPrefix)) {
+            return line.substr(configurationPrefix.size());
+        }
+    }
+    return {};
+}
+
+// Each line is "<counter> min|max <value>", # starts a comment
+int checkThresholds(const Report& report, const std::filesystem::path& path)
+{
+    auto input = std::ifstream{path};
+    if (!input) {
+        throw gx::Error{"cannot read thresholds " + path.string()};
+    }
+
+    int failures = 0;
+    for (std::string line; std::getline(input, line); ) {
+        line = line.substr(0, line.find('#'));
+        auto stream = std::istringstream{line};
+        auto name = std::string{};
+        auto bound = std::string{};
+        double limit = 0.0;
+        if (!(stream >> name)) {
+            continue;
+        }
+        if (!(stream >> bound >> limit) || (bound != "min" && bound != "max")) {
+            throw gx::Error{"bad threshold line: " + line};
+        }
+
+        auto it = report.find(name);
+        if (it == report.end()) {
+            throw gx::Error{"unknown counter in thresholds: " + name};
+        }
+        auto value = it->second;
+        if ((bound == "max" && value > limit) ||
+                (bound == "min" && value < limit)) {
+            std::cout << "REGRESSION " << name << " = " << value <<
+                " (" << bound << " " << limit << ")\n";
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Frame times vary from run to run on the same machine, so their limits
+// leave this much room above the baseline. The slowest frame is a single
+// sample and gets more.
+constexpr double frameTimeMargin = 1.0;
+constexpr double frameMaxMargin = 3.0;
+// Frame arena use depends on the widgets' allocation patterns, not timing
+constexpr double arenaMargin = 1.0;
+
+// Writes limits derived from a measured run, together with the run's
+// configuration and every measured value
+void writeBaseline(
+    const Report& report,
+    const Options& options,
+    const std::filesystem::path& path)
+{
+    auto output = std::ofstream{path};
+    if (!output) {
+        throw gx::Error{"cannot write baseline " + path.string()};
+    }
+
+    output << "# Limits checked by gx-stress, written by gx-stress --baseline\n"
+        "#\n"
+        "# <counter> min|max <value>\n"
+        "#\n"
+        "# Runs with a different configuration do not check them.\n"
+        "#\n" <<
+        configurationPrefix << describeConfiguration(options) << "\n"
+        "#\n"
+        "# Measured:\n";
+    for (const auto& [name, value] : report) {
+        output << "#   " << name << " " << value << "\n";
+    }
+
+    auto limit = [&] (const std::string& name, const char* bound,
+            double value) {
+        output << std::left << std::setw(32) << name << bound << " " <<
+            value << "\n";
+    };
+
+    output << "\n# Measured frame times plus " << frameTimeMargin * 100 <<
+        "%, the slowest frame plus " << frameMaxMargin * 100 << "%.\n"
+        "# Regenerate after a change makes things faster, so that the gain "
+        "is kept.\n";
+    for (const auto* name : {"frame_p50_ms", "frame_p95_ms", "frame_p99_ms"}) {
+        limit(name, "max", report.at(name) * (1 + frameTimeMargin));
+    }
+    limit(
+        "frame_max_ms",
+        "max",
+        report.at("frame_max_ms") * (1 + frameMaxMargin));
+
+    output << "\n# The session is deterministic, so these only change with "
+        "the scenario\n";
+    limit("frames", "min", report.at("frames"));
+    limit("bullets_spawned", "min", report.at("bullets_spawned"));
+    limit("scene_commands_rejected", "max", 0);
+    limit("scene_spawns_rejected", "max", 0);
+
+    output << "\n# Measured high water plus " << arenaMargin * 100 << "%\n";
+    limit(
+        "frame_arena_high_water_bytes",
+        "max",
+        std::ceil(report.at("frame_arena_high_water_bytes") *
+            (1 + arenaMargin)));
+    limit("frame_arena_overflows", "max", 0);
+}
+
+int run(const Options& options)
+{
+    bool recording = !options.record.empty();
+
+    auto box = gx::Box{gx::WindowConfig{
+        .title = "gx-stress",
+        .size = options.size,
+        .vsync = recording,
+        .headless = !recording,
+        .blitter = options.blitterThreads.has_value(),
+        .blitterThreads = options.blitterThreads.value_or(0),
+        .dirtyRectangles = options.dirtyRectangles,
+    }};
+
+    auto r = Resources{};
+    loadResources(box, r);
+
+    auto* scene = box.createWidget<gx::Scene>();
+    scene->setupCamera({0, 0}, 16, 2);
+
+    auto random = std::mt19937{1};
+    auto coordinate = std::uniform_real_distribution<float>{-40.f, 40.f};
+    for (size_t i = 0; i < options.objects; i++) {
+        scene->spawn(r.treeSprite, {coordinate(random), coordinate(random)});
+    }
+    auto* hero = scene->spawn(r.heroSprite, {0, 0});
+    scene->cameraFollow(hero);
+
+    for (int i = 0; i < 16; i++) {
+        auto x = gx::UiCoordinate{.pixels = 80.f + 140.f * (float)(i % 4)};
+        auto y = gx::UiCoordinate{.pixels = 30.f + 40.f * (float)(i / 4)};
+        auto* button = box.createWidget<gx::Button>()
+            ->position(x, y)
+            ->textSprite(r.labelSprite);
+        // Every other button animates, so the UI layer keeps changing
+        if (i % 2 == 0) {
+            button->buttonSprite(r.pressAnimationSprite);
+        } else {
+            button->buttonSprite(r.buttonSprite);
+        }
+    }
+
+    auto simulation = Simulation{};
+    simulation.bulletSprite = &r.bulletSprite;
+    simulation.pending.reserve(simulation.commands.capacity());
+    scene->clickAction([&simulation] (const gx::WorldPoint& point) {
+        simulation.shoot(point);
+    });
+
+    auto frameSeconds = std::vector<double>{};
+    frameSeconds.reserve(options.frames);
+    auto frequency = (double)SDL_GetPerformanceFrequency();
+    Uint64 lastFrame = 0;
+
+    auto loop = gx::Loop{
+        .onEvent = [&simulation] (const SDL_Event& e) {
+            simulation.processEvent(e);
+            return false;
+        },
+        .onStep = [&simulation] (float delta) {
+            simulation.step(delta);
+        },
+        .onFrame = [&] (float) {
+            auto now = SDL_GetPerformanceCounter();
+            if (lastFrame != 0) {
+                frameSeconds.push_back((double)(now - lastFrame) / frequency);
+            }
+            lastFrame = now;
+
+            scene->apply(simulation.commands);
+            hero->position = simulation.hero;
+        },
+    };
+
+    auto player = std::unique_ptr<gx::ReplayPlayer>{};
+    auto recorder = std::unique_ptr<gx::ReplayRecorder>{};
+    if (recording) {
+        recorder = std::make_unique<gx::ReplayRecorder>(options.record);
+        loop.recorder = recorder.get();
+    } else if (!options.replay.empty()) {
+        player = std::make_unique<gx::ReplayPlayer>(options.replay);
+        loop.player = player.get();
+    } else {
+        player = std::make_unique<gx::ReplayPlayer>(
+            scriptedSession(options.frames, box.renderer().windowSize()));
+        loop.player = player.get();
+    }
+
+    if (!options.capture.empty()) {
+        box.renderer().startCapture({
+            .path = options.capture,
+            .format = options.capture.extension() == ".y4m" ?
+                gx::CaptureFormat::Y4m : gx::CaptureFormat::PngSequence,
+        });
+    }
+    box.run(loop);
+    box.renderer().stopCapture();
+
+    if (recording) {
+        std::cout << "recorded " << options.record.string() << "\n";
+        return 0;
+    }
+
+    std::ranges::sort(frameSeconds);
+    auto commandStats = simulation.commands.stats();
+    auto captureStats = box.renderer().captureStats();
+    auto report = Report{
+        {"frames", (double)frameSeconds.size() + 1},
+        {"frame_p50_ms", percentile(frameSeconds, 0.50) * 1000},
+        {"frame_p95_ms", percentile(frameSeconds, 0.95) * 1000},
+        {"frame_p99_ms", percentile(frameSeconds, 0.99) * 1000},
+        {"frame_max_ms", frameSeconds.empty() ? 0.0 :
+            frameSeconds.back() * 1000},
+        {"bullets_spawned", (double)simulation.bulletsSpawned},
+        {"scene_commands", (double)commandStats.published},
+        {"scene_commands_rejected", (double)commandStats.rejected},
+        {"scene_commands_high_water", (double)commandStats.highWater},
+        {"scene_spawns_rejected", (double)scene->rejectedSpawns()},
+        {"frame_arena_high_water_bytes",
+            (double)box.frameArena().stats().highWater},
+        {"frame_arena_overflows", (double)box.frameArena().stats().overflows},
+        {"capture_frames", (double)captureStats.captured},
+        {"capture_dropped", (double)captureStats.dropped},
+        {"capture_mean_ms", captureStats.meanCaptureSeconds * 1000},
+        {"capture_max_ms", captureStats.maxCaptureSeconds * 1000},
+        {"capture_encode_mean_ms", captureStats.meanEncodeSeconds * 1000},
+    };
+    for (const auto& [name, value] : report) {
+        std::cout << name << " " << value << "\n";
+    }
+
+    if (!options.baseline.empty()) {
+        writeBaseline(report, options, options.baseline);
+        std::cout << "wrote baseline " << options.baseline.string() << "\n";
+        return 0;
+    }
+
+    auto configuration = describeConfiguration(options);
+    auto measured = baselineConfiguration(options.thresholds);
+    if (!measured.empty() && measured != configuration) {
+        std::cout << "thresholds were measured with " << measured <<
+            "; not checking them for " << configuration << "\n";
+        return 0;
+    }
+
+    auto failures = checkThresholds(report, options.thresholds);
+    if (failures > 0) {
+        std::cout << failures << " threshold(s) exceeded\n";
+        return 1;
+    }
+    std::cout << "all thresholds met\n";
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    try {
+        return run(parseOptions(argc, argv));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 2;
+    }
+}
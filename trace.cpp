@@ -0,0 +1,348 @@
+#include <gx/trace.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace gx {
+
+namespace {
+
+constexpr size_t ringSize = size_t{1} << 16;
+
+// Written by the owning thread only, read by whoever dumps the trace. The
+// sequence is odd while the slot is being written, so readers can skip
+// slots that changed under them.
+struct ZoneSlot {
+    std::atomic<std::uint32_t> sequence {0};
+    std::atomic<const char*> name {nullptr};
+    std::atomic<Uint64> start {0};
+    std::atomic<Uint64> end {0};
+};
+
+struct ThreadBuffer {
+    explicit ThreadBuffer(std::uint32_t id)
+        : id(id)
+        , slots(std::make_unique<ZoneSlot[]>(ringSize))
+    { }
+
+    const std::uint32_t id;
+    size_t next = 0;
+    std::unique_ptr<ZoneSlot[]> slots;
+};
+
+struct Zone {
+    const char* name = nullptr;
+    Uint64 start = 0;
+    Uint64 end = 0;
+    std::uint32_t thread = 0;
+};
+
+// Buffers outlive their threads, so that a dump still shows what a finished
+// worker did
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+struct FrameState {
+    std::mutex mutex;
+    TraceConfig config;
+    std::uint64_t frame = 0;
+    Uint64 lastFrameEnd = 0;
+    // End times of the last frames, indexed by frame number
+    std::vector<Uint64> frameEnds;
+    std::uint64_t lastDumpFrame = 0;
+};
+
+Registry& registry()
+{
+    static auto registry = Registry{};
+    return registry;
+}
+
+FrameState& frameState()
+{
+    static auto state = FrameState{};
+    return state;
+}
+
+ThreadBuffer& threadBuffer()
+{
+    thread_local auto* buffer = [] {
+        auto& r = registry();
+        auto lock = std::lock_guard{r.mutex};
+        auto id = static_cast<std::uint32_t>(r.buffers.size() + 1);
+        return r.buffers.emplace_back(std::make_unique<ThreadBuffer>(id))
+            .get();
+    }();
+    return *buffer;
+}
+
+void record(const char* name, Uint64 start, Uint64 end)
+{
+    auto& buffer = threadBuffer();
+    auto& slot = buffer.slots[buffer.next++ & (ringSize - 1)];
+
+    auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+std::vector<Zone> collectZones(Uint64 since)
+{
+    auto buffers = std::vector<ThreadBuffer*>{};
+    {
+        auto& r = registry();
+        auto lock = std::lock_guard{r.mutex};
+        for (const auto& buffer : r.buffers) {
+            buffers.push_back(buffer.get());
+        }
+    }
+
+    auto zones = std::vector<Zone>{};
+    for (const auto* buffer : buffers) {
+        for (size_t i = 0; i < ringSize; i++) {
+            const auto& slot = buffer->slots[i];
+            auto sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence == 0 || sequence % 2 != 0) {
+                continue;
+            }
+            auto zone = Zone{
+                .name = slot.name.load(std::memory_order_relaxed),
+                .start = slot.start.load(std::memory_order_relaxed),
+                .end = slot.end.load(std::memory_order_relaxed),
+                .thread = buffer->id,
+            };
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+                continue;
+            }
+            if (zone.end >= since) {
+                zones.push_back(zone);
+            }
+        }
+    }
+
+    std::ranges::sort(zones, {}, &Zone::start);
+    return zones;
+}
+
+void writeName(std::ostream& output, const char* name)
+{
+    output << '"';
+    for (const char* c = name; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            output << '\\';
+        }
+        output << *c;
+    }
+    output << '"';
+}
+
+void writeZones(std::ostream& output, const std::vector<Zone>& zones)
+{
+    auto frequency = (double)SDL_GetPerformanceFrequency();
+    auto base = zones.empty() ? Uint64{0} : zones.front().start;
+    auto microseconds = [frequency] (Uint64 ticks) {
+        return (double)ticks * 1e6 / frequency;
+    };
+
+    auto flags = output.flags();
+    auto precision = output.precision();
+    output << std::fixed << std::setprecision(3);
+
+    output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < zones.size(); i++) {
+        const auto& zone = zones.at(i);
+        output << (i == 0 ? "\n" : ",\n") << "{\"name\":";
+        writeName(output, zone.name);
+        output << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << zone.thread <<
+            ",\"ts\":" << microseconds(zone.start - base) <<
+            ",\"dur\":" << microseconds(zone.end - zone.start) << "}";
+    }
+    output << "\n]}\n";
+
+    output.flags(flags);
+    output.precision(precision);
+}
+
+struct Dump {
+    std::filesystem::path path;
+    std::vector<Zone> zones;
+};
+
+// Writes hitch dumps on a thread of its own, so that a slow frame is not
+// followed by a slower one spent writing JSON
+class DumpWriter {
+public:
+    ~DumpWriter()
+    {
+        {
+            auto lock = std::lock_guard{_mutex};
+            _stopping = true;
+        }
+        _queuedChanged.notify_all();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    void write(Dump dump)
+    {
+        {
+            auto lock = std::lock_guard{_mutex};
+            // Only hitches in quick succession can pile up, and the first
+            // one tells the most
+            if (_queued.size() >= maxQueued) {
+                _stats.droppedDumps++;
+                return;
+            }
+            _queued.push_back(std::move(dump));
+            if (!_thread.joinable()) {
+                _thread = std::thread{[this] { work(); }};
+            }
+        }
+        _queuedChanged.notify_one();
+    }
+
+    TraceStats stats() const
+    {
+        auto lock = std::lock_guard{_mutex};
+        return _stats;
+    }
+
+private:
+    static constexpr size_t maxQueued = 2;
+
+    void work()
+    {
+        auto lock = std::unique_lock{_mutex};
+        while (true) {
+            _queuedChanged.wait(
+                lock, [this] { return _stopping || !_queued.empty(); });
+            if (_queued.empty()) {
+                return;
+            }
+            auto dump = std::move(_queued.front());
+            _queued.pop_front();
+            lock.unlock();
+
+            auto output = std::ofstream{dump.path};
+            if (output) {
+                writeZones(output, dump.zones);
+                output.close();
+            }
+            bool written = !output.fail();
+
+            lock.lock();
+            if (written) {
+                _stats.writtenDumps++;
+            } else {
+                _stats.failedDumps++;
+                _stats.lastError = "cannot write trace to " +
+                    dump.path.string();
+            }
+        }
+    }
+
+    mutable std::mutex _mutex;
+    std::condition_variable _queuedChanged;
+    std::deque<Dump> _queued;
+    bool _stopping = false;
+    TraceStats _stats;
+    std::thread _thread;
+};
+
+DumpWriter& dumpWriter()
+{
+    static auto writer = DumpWriter{};
+    return writer;
+}
+
+} // namespace
+
+void configureTrace(const TraceConfig& config)
+{
+    auto& state = frameState();
+    auto lock = std::lock_guard{state.mutex};
+    state.config = config;
+    state.frameEnds.assign(config.frames + 1, 0);
+}
+
+TraceZone::~TraceZone()
+{
+    record(_name, _start, SDL_GetPerformanceCounter());
+}
+
+void traceFrame()
+{
+    auto now = SDL_GetPerformanceCounter();
+
+    auto& state = frameState();
+    auto dump = Dump{};
+    auto since = Uint64{0};
+    {
+        auto lock = std::lock_guard{state.mutex};
+
+        auto frameStart = state.lastFrameEnd;
+        state.lastFrameEnd = now;
+        state.frame++;
+        if (frameStart == 0) {
+            return;
+        }
+        record("Frame", frameStart, now);
+
+        const auto& config = state.config;
+        if (config.budgetSeconds <= 0.f || state.frameEnds.empty()) {
+            return;
+        }
+        state.frameEnds.at(state.frame % state.frameEnds.size()) = now;
+
+        auto seconds = (double)(now - frameStart) /
+            (double)SDL_GetPerformanceFrequency();
+        // Dumps do not overlap, so a stall of several frames is one file
+        if (seconds <= config.budgetSeconds ||
+                state.frame < state.lastDumpFrame + config.frames) {
+            return;
+        }
+        state.lastDumpFrame = state.frame;
+
+        // The oldest kept frame end is where the first dumped frame starts
+        since = state.frameEnds.at(
+            (state.frame + 1) % state.frameEnds.size());
+        dump.path = config.directory /
+            ("gx-hitch-" + std::to_string(state.frame) + ".json");
+    }
+
+    // Zones are copied right away, before the rings overwrite them, and
+    // written later
+    dump.zones = collectZones(since);
+    dumpWriter().write(std::move(dump));
+}
+
+TraceStats traceStats()
+{
+    return dumpWriter().stats();
+}
+
+void writeTrace(std::ostream& output)
+{
+    writeZones(output, collectZones(0));
+}
+
+} // namespace gx